@@ -1,38 +1,141 @@
 /* arena.h - v0.1 - public domain memory arena allocator
     DEPENDENCIES:
-	- Requires <stdlib.h> for malloc/free
         - Requires <sys/mman.h> for mmap/munmap
+        - Requires <pthread.h> for thread-local arenas (link with -pthread)
+        - GCC/Clang for __thread and __atomic builtins
         - POSIX systems _only_
         - NOT compatible with Windows
 
     API DOCUMENTATION:
 	### Arena Types
-    	Two types of memory arenas are supported:
+    	Four types of memory arenas are supported:
 
-	- AR_FIXED: Fixed-size arena (64KB by default)
+	- AR_FIXED: Fixed-size arena (16 pages by default)
 	    * When capacity is reached, new allocations fail
 
 	- AR_DYNAMIC:
-	    * Allocates memory in chunks
+	    * Allocates memory in chunks, one mapping each
 	    * When current chunk reaches capacity limit a new chunk gets created
 	    * Chunk capacity doubles with each expansion
 	    * All previous allocations remain valid
-	    * Starts at 4KB
+	    * Starts at one page
+
+	- AR_VIRTUAL:
+	    * Reserves one large virtual range up front (8GB by default)
+	    * Pages are committed with mprotect as the offset grows
+	    * Allocations are contiguous, there is no chunk list
+	    * When the reservation is exhausted, new allocations fail
+
+	- AR_SHARED:
+	    * AR_DYNAMIC that many threads can aralloc from concurrently
+	    * Allocation is an atomic fetch-add on the chunk offset
+	    * Growth takes a short spinlock, only one thread maps the new chunk
+	    * arreset, armark and arrewind need all allocating threads to be
+	      stopped, as does arfree
 
 	### API
 	struct Arena *arinit(ArenaType type);
 		Initializes an arena of <type>.
 
 		Parameters:
-		- type: AR_FIXED or AR_DYNAMIC
+		- type: AR_FIXED, AR_DYNAMIC, AR_VIRTUAL or AR_SHARED
+
+		Returns:
+		- Pointer to initialed arena on success.
+		- NULL on failure.
+
+		Notes:
+		- AR_FIXED arenas start with 16 pages of memory (64KB with 4KB
+		  pages)
+		- AR_DYNAMIC and AR_SHARED arenas starts with 1 page and
+		  grow as needed.
+		- AR_VIRTUAL arenas reserve AR_VIRTUAL_RESERVE bytes of address
+		  space and commit 16 pages; the reservation costs no memory.
+		- Pages are sysconf(_SC_PAGESIZE) bytes.
+		- No malloc: each chunk's header sits at the start of its
+		  mapping, and the Arena itself in the first chunk.
+
+	struct Arena *arinit_ex(const ArenaConfig *config);
+		Initializes an arena sized and grown as <config> says.
+
+		Parameters:
+		- config->type: backend, any ArenaType
+		- config->initial_size: usable bytes of the first chunk
+		  (AR_VIRTUAL: first commit), headers come on top and the
+		  total is rounded up to whole pages
+		- config->growth_factor: each new chunk (AR_VIRTUAL: commit) is
+		  the previous one times this, 2 if 0
+		- config->growth_step: if not 0, grow linearly by this many bytes
+		  instead of by growth_factor
+		- config->max_size: if not 0, growth fails rather than hold more
+		  chunk bytes than this (AR_VIRTUAL: size of the reservation)
+		- config->flags: AR_HUGEPAGES, AR_PREFAULT, AR_NUMA_BIND or
+		  AR_NUMA_LOCAL, AR_GUARD_PAGES, AR_REFILL, or 0. AR_READONLY
+		  is for arinit_file, arinit_ex fails on it.
+		- config->numa_node: node for AR_NUMA_BIND
+		- config->large_size: AR_DYNAMIC and AR_SHARED allocations of
+		  this many bytes or more that don't fit the current chunk get
+		  a mapping of their own, see aralloc. If 0, those larger than
+		  the next chunk would be. (size_t)-1 turns this off.
+		- config->refill_percent: AR_REFILL fill threshold of the
+		  current chunk, 1 to 100, 75 if 0
 
 		Returns:
 		- Pointer to initialed arena on success.
 		- NULL on failure.
 
 		Notes:
-		- AR_FIXED arenas start with 64KB of memory (16 pages)
-		- AR_DYNAMIC arenas starts with 4KB (1 page) and grow as needed.
+		- arinit(type) is arinit_ex with only <type> set.
+		- A chunk is never smaller than the allocation that needs it.
+		- AR_HUGEPAGES: chunks of 2MB and more are rounded to 2MB
+		  multiples and mapped with MAP_HUGETLB, or, when the huge page
+		  pool is empty, 2MB aligned with madvise(MADV_HUGEPAGE).
+		  AR_VIRTUAL reservations only use madvise(MADV_HUGEPAGE).
+
+		- AR_PREFAULT: new chunks are faulted in when they are mapped
+		  (MAP_POPULATE), as are reused cached chunks and AR_VIRTUAL
+		  commits, so first touch never page faults.
+
+		- AR_NUMA_BIND: every chunk is mbind-ed (MPOL_BIND) to node
+		  config->numa_node, 0 to 63. arinit_ex fails if the node
+		  can't be bound to.
+		- AR_NUMA_LOCAL: the same for the node of the calling thread,
+		  left unbound where NUMA isn't available.
+
+		- AR_GUARD_PAGES: every chunk is followed by a PROT_NONE page,
+		  running off its end faults. Guarded chunks skip the chunk
+		  cache and huge pages. AR_VIRTUAL needs no guard, the
+		  uncommitted reservation already faults.
+
+		- AR_REFILL (AR_DYNAMIC): once the current chunk is
+		  refill_percent full and no retained chunk follows it, a
+		  helper thread maps, binds and, with AR_PREFAULT, faults in
+		  the next one. Growth then links it without a syscall, or
+		  maps one as usual if it isn't ready. The helper is started
+		  on first use and serves every arena; its chunk isn't counted
+		  by arstats until it is linked.
+
+	size_t arhuge_bytes(Arena* arena);
+		Reports how many bytes of the arena are backed by MAP_HUGETLB.
+
+		Notes:
+		- Transparent huge pages are up to the kernel and not counted.
+
+	int arstats(Arena* arena, ArenaStats *stats);
+		Fills <stats> with what the arena holds and how it's used.
+
+		Returns:
+		- 0 on success, -1 if <arena> or <stats> is NULL.
+
+		Notes:
+		- Layout figures (allocated, committed, chunks, wasted) are read
+		  from the chunks and always available.
+		- requested, padding, peak, expansions and resets are counted
+		  when ARENA_STATS is defined. Define it for the implementation
+		  and every ARENA_INLINE user, without it the counters compile
+		  to nothing.
+		- AR_SHARED: only exact while no thread allocates, the tail of a
+		  chunk a bump overshot counts as allocated.
 
 	void arfree(Arena* arena);
 		Used to deallocate an arena.
@@ -42,6 +145,7 @@
 
 		Notes:
 		- aralloc-ated variables become invalid.
+		- Chunks go to the chunk cache, see arcache_limit.
 
 	void* aralloc(Arena* arena, size_t size);
 		Allocates memory from the arena.
@@ -52,11 +156,82 @@
 
 		Returns:
 		- Pointer to allocated memory on success.
-		- NULL on failure (arena full for AR_FIXED, or out of memory).
+		- NULL on failure (arena full for AR_FIXED, reservation exhausted
+		  for AR_VIRTUAL, or out of memory).
 
 		Notes:
-		- All allocations are 16-byte aligned.
+		- All allocations are 16-byte aligned, see aralloc_aligned for
+		  other alignments.
 		- For AR_DYNAMIC, allocations may cause expansion.
+		- For AR_VIRTUAL, allocations may commit more pages in place.
+		- Large allocations (ArenaConfig.large_size) are mapped on their
+		  own, off the chunk chain: the current chunk stays current and
+		  growth isn't sized after them. arreset and arrewind hand their
+		  mappings back to the chunk cache, where the next large
+		  allocation can reuse them.
+
+	void* aralloc_aligned(Arena* arena, size_t size, size_t align);
+		Allocates memory from the arena at an address aligned to <align>.
+
+		Parameters:
+		- arena: pointer to the arena
+		- size: number of bytes to allocate
+		- align: required alignment, a power of two (1 up to page size
+		  and beyond, i.e. 4096 for O_DIRECT buffers)
+
+		Returns:
+		- Pointer to allocated memory on success.
+		- NULL on failure, or if <align> is not a power of two.
+
+		Notes:
+		- Only the address is aligned, <size> is used as is: small
+		  alignments pack tiny objects without padding.
+		- AR_SHARED rounds sizes to 16 bytes and aligns to at least 16.
+
+	void* aralloc_batch(Arena* arena, size_t size, size_t count, void **out);
+		Allocates <count> objects of <size> bytes with a single
+		capacity check and at most one expansion.
+
+		Parameters:
+		- arena: pointer to the arena
+		- size: bytes per object
+		- count: number of objects
+		- out: if not NULL, receives a pointer to each of the objects
+
+		Returns:
+		- Pointer to the first object, the others follow every
+		  AR_ALIGN_UP(size) bytes (each is 16-byte aligned).
+		- NULL on failure or if <count> is 0, <out> is left untouched.
+
+	void* arcalloc(Arena* arena, size_t count, size_t size);
+		Allocates <count> * <size> zeroed bytes, 16-byte aligned.
+
+		Returns:
+		- Pointer to zeroed memory on success.
+		- NULL on failure, or if <count> * <size> overflows.
+
+		Notes:
+		- Each chunk tracks how far it was ever used. Memory past that
+		  mark is untouched mmap memory and already zero, only bytes
+		  reused after arreset/arrewind/arrealloc are cleared (memset).
+		- AR_SHARED always clears the whole allocation.
+
+	void* aralloc_slow(Arena* arena, size_t size, size_t align);
+		Growth path of aralloc: expands (AR_DYNAMIC) or commits
+		(AR_VIRTUAL) so that <size> bytes fit, then allocates them.
+
+		Notes:
+		- Called by aralloc/aralloc_fast once the current chunk is full,
+		  rarely useful on its own.
+
+	static inline void* aralloc_fast(Arena* arena, size_t size);
+		Inlined aralloc, only available with ARENA_INLINE defined.
+
+		Notes:
+		- Bumps the current chunk in place, falls back to aralloc_slow.
+		- <arena> must not be NULL, nor an AR_SHARED arena.
+		- Define ARENA_INLINE identically in every file including arena.h,
+		  it exposes struct Arena/struct Chunk.
 
 	void arreset(Arena* arena);
 		Resets the arena to initial state
@@ -65,11 +240,459 @@
 		- arena: pointer to arena to reset.
 
 		Notes:
-		- AR_FIXED: offeset is set to 0
+		- AR_FIXED/AR_VIRTUAL: offeset is set to 0, committed pages are kept
 		- AR_DYNAMIX: Rewinds all chunk offsets, _keeps all chunks_.
+		  Growth reuses the first kept chunk large enough before
+		  mapping a new one.
 		- Allocation on a reset arena overwrite previously allocated
 		  data. Accessing such data is _undefined behavior_.
 
+	void* arrealloc(Arena* arena, void *old, size_t old_size, size_t new_size);
+		Resizes an allocation.
+
+		Parameters:
+		- arena: pointer to the arena <old> was allocated from
+		- old: allocation to resize, NULL to just aralloc <new_size>
+		- old_size: size <old> was allocated (or last resized) with
+		- new_size: size wanted
+
+		Returns:
+		- <old> if it could be resized in place.
+		- Pointer to a new allocation holding the first <old_size> bytes
+		  of <old>, which only gets reclaimed on arreset.
+		- NULL on failure, <old> stays valid.
+
+		Notes:
+		- The most recent allocation is extended or shrunk in place when
+		  the chunk has room (AR_VIRTUAL commits more pages in place), so
+		  appending to the last buffer is amortized O(1).
+		- Shrinking any other allocation returns it unchanged.
+		- A moved allocation is 16-byte aligned, whatever <old> had.
+		- AR_SHARED always allocates and copies when growing.
+
+	void arreset_ex(Arena* arena, ArenaResetPolicy policy);
+		Resets the arena, then releases memory as <policy> says.
+
+		Parameters:
+		- arena: pointer to arena to reset.
+		- policy.mode:
+		  * AR_RESET_KEEP: nothing, same as arreset
+		  * AR_RESET_TRIM: keeps chunks while they add up to at most
+		    policy.keep bytes (at least the first one) and unmaps the
+		    rest. AR_VIRTUAL decommits past policy.keep, AR_FIXED gives
+		    the pages past it back with MADV_DONTNEED.
+		  * AR_RESET_FREE: keeps every chunk but MADV_FREEs the pages
+		    past policy.keep bytes, the kernel reclaims them lazily.
+		  * AR_RESET_ADAPTIVE: AR_RESET_TRIM with policy.keep set to the
+		    90th percentile of the usage seen by the last 16 resets.
+		    AR_DYNAMIC and AR_SHARED count the capacity of the chunks
+		    that were in use, so a steady workload keeps its chunks.
+		  * AR_RESET_COALESCE: AR_DYNAMIC and AR_SHARED swap the chunks
+		    after the first, which holds the arena, for one chunk of
+		    the same total capacity, so a steady workload ends up in
+		    contiguous memory. The chain is kept if the new chunk
+		    can't be mapped.
+		- policy.keep: bytes to keep for TRIM and FREE.
+
+		Notes:
+		- Every reset (arreset included) records the usage at the time.
+		- Unmapped chunks go to the chunk cache, see arcache_limit.
+
+	int arreserve(Arena* arena, size_t size);
+		Makes sure the next <size> bytes of aralloc-ations fit in the
+		current chunk, and faults them in.
+
+		Parameters:
+		- arena: pointer to the arena
+		- size: bytes to have ready
+
+		Returns:
+		- 0 on success.
+		- -1 on failure (don't fit in an AR_FIXED arena or the
+		  AR_VIRTUAL reservation, or out of memory).
+
+		Notes:
+		- AR_DYNAMIC: moves to a new chunk if the current one is too
+		  small, abandoning its tail.
+		- AR_SHARED: safe next to allocating threads, which may
+		  take the reserved bytes first.
+		- Padding of differently aligned allocations is not accounted.
+
+	ArenaMark armark(Arena* arena);
+		Captures the current position of the arena.
+
+		Returns:
+		- A mark to pass to arrewind.
+		- An empty mark if <arena> is NULL, rewinding to it does nothing.
+
+	void arrewind(Arena* arena, ArenaMark mark);
+		Releases everything allocated since <mark> was taken, in O(1).
+
+		Parameters:
+		- arena: pointer to the arena the mark was taken from
+		- mark: value returned by armark
+
+		Notes:
+		- Marks nest like a stack: rewinding to a mark invalidates all
+		  marks taken after it.
+		- A mark is invalidated by arreset.
+		- Chunks grown past the mark are kept and reused.
+
+	### Thread-local arenas
+	Arena *arthread_local(ArenaType type);
+		Returns the calling thread's arena of <type>, creating it on
+		first use.
+
+		Returns:
+		- Pointer to the thread's arena on success.
+		- NULL on failure.
+
+		Notes:
+		- No locking: the arena belongs to the calling thread only.
+		- Arenas released by any thread are reused before arinit is
+		  called, taking one from the idle list is lock-free.
+		- Don't arfree the returned arena, release it instead.
+
+	void arthread_release(ArenaType type);
+		Resets the calling thread's arena of <type> and hands it to the
+		idle list, where any thread can pick it up.
+
+		Notes:
+		- Runs automatically for every type when a thread exits.
+		- Allocations from the released arena become invalid.
+
+	void arthread_numa(int enable);
+		With <enable> set, arenas arthread_local creates from then on
+		are AR_NUMA_LOCAL to the calling thread, and a thread only
+		picks up idle arenas of its own node. Off by default.
+
+		Notes:
+		- The node is the one the thread runs on when it first asks for
+		  its arena, pin workers to keep them local.
+
+	void arthread_purge(void);
+		Frees every idle arena.
+
+		Notes:
+		- Arenas still owned by a thread are not affected.
+
+	### Chunk cache
+	Chunks freed by arfree are kept mapped, with their pages returned
+	to the kernel via madvise (ARENA_CACHE_ADVICE, MADV_DONTNEED by
+	default), and reused by the next arena that needs a chunk that size.
+	MAP_HUGETLB and AR_GUARD_PAGES chunks are unmapped instead.
+
+	size_t arcache_limit(size_t bytes);
+		Sets how many bytes of chunks the cache may hold.
+
+		Returns:
+		- The previous limit (ARENA_CACHE_MAX, 64MB, by default).
+
+		Notes:
+		- 0 disables the cache.
+		- Lowering the limit unmaps cached chunks above it.
+
+	void arcache_purge(void);
+		Unmaps every cached chunk.
+
+	### File-backed arenas
+	Arena *arinit_file(const char *path, size_t capacity, unsigned flags);
+		Opens, or creates, an AR_FIXED arena living in the file at
+		<path>, mapped MAP_SHARED. What was allocated in it is there
+		again the next time the file is opened, without copying.
+
+		Parameters:
+		- path: file holding the arena
+		- capacity: usable bytes, the file is grown to fit them. 0
+		  keeps the size of an existing file.
+		- flags: AR_PREFAULT, and AR_READONLY to open an existing file
+		  without writing to it, e.g. an index shared by processes.
+		  aralloc, arrealloc and arreserve fail on it.
+
+		Returns:
+		- Pointer to the arena, NULL on failure or if the file is not
+		  an arena file of this version.
+
+		Notes:
+		- The file may map at another address every time, store
+		  aroffset values rather than pointers inside it.
+		- Only one writable arena per file at a time.
+		- arfree unmaps without syncing, the kernel writes the pages
+		  back; arsync to be sure they reached the disk.
+		- arreset forgets everything in the file, root included, and
+		  does nothing to an AR_READONLY one. arrewind drops the root
+		  if it was allocated after the mark.
+
+	int arsync(Arena* arena);
+		msyncs what the file arena holds. 0 on success, -1 on failure
+		or if <arena> is not a writable file arena.
+
+	size_t aroffset(Arena* arena, const void *ptr);
+	void *arptr(Arena* arena, size_t offset);
+		Convert between pointers into the arena's first chunk and
+		offsets, which stay valid across mappings. NULL and 0 map to
+		each other, as do pointers and offsets outside the chunk.
+
+	int arroot_set(Arena* arena, const void *ptr);
+	void *arroot_get(Arena* arena);
+		Store and fetch the object a file arena is reached from.
+		arroot_set returns 0, or -1 if <arena> is not a writable file
+		arena or <ptr> is not in it.
+
+		typedef struct { size_t names; size_t count; } Index;
+
+		Arena *arena = arinit_file("index.ar", 1 << 30, 0);
+		Index *index = arroot_get(arena);
+		if (!index) {
+			index = aralloc(arena, sizeof(*index));
+			// ... build it, link it with aroffset ...
+			arroot_set(arena, index);
+			arsync(arena);
+		}
+
+	### Containers
+	Growable arrays and strings living in an arena. They grow with
+	arrealloc, so the most recently grown container extends in place,
+	and they are freed with the arena (arreset/arrewind/arfree).
+
+	ArenaVec(T)
+		Anonymous struct { T *data; size_t len; size_t cap; },
+		typedef it and zero-initialize it:
+
+		typedef ArenaVec(int) IntVec;
+		IntVec v = { 0 };
+		arvec_push(arena, &v, 42);
+
+	int arvec_push(arena, vec, value);      // 0, or -1 out of memory
+	int arvec_reserve(arena, vec, n);       // room for <n> elements
+	T arvec_pop(vec);                      // <vec> must not be empty
+	arvec_clear(vec);                      // len = 0, capacity is kept
+
+	Notes:
+	- Arguments may be evaluated more than once.
+	- Growing moves elements, pointers into <data> become stale.
+
+	int arstr_append(Arena* arena, ArenaStr *str, const char *src, size_t n);
+	int arstr_puts(Arena* arena, ArenaStr *str, const char *src);
+	int arstr_putc(Arena* arena, ArenaStr *str, char c);
+		Append to a zero-initialized ArenaStr, str->data stays NUL
+		terminated.
+
+		Returns:
+		- 0 on success.
+		- -1 on failure, <str> is unchanged.
+
+	### Object pools
+	ArenaPool *arpool_init(Arena* arena, size_t obj_size);
+		Creates a pool of <obj_size> objects inside <arena>.
+
+		Returns:
+		- Pointer to the pool on success.
+		- NULL on failure.
+
+		Notes:
+		- Objects are 16-byte aligned, 8-byte aligned below 16 bytes.
+		- The pool and its objects belong to the arena: arreset,
+		  arrewind past arpool_init and arfree destroy them all at once.
+
+	void *arpool_alloc(ArenaPool *pool);
+		O(1): reuses the last freed object, or carves one from the
+		current slab. Slabs come from aralloc and grow up to 16 pages.
+
+		Returns:
+		- Pointer to an uninitialized object, NULL out of memory.
+
+	void arpool_free(ArenaPool *pool, void *obj);
+		O(1): returns <obj> to <pool> for reuse. NULL is ignored.
+
+	### Arena rings
+	int arring_init(ArenaRing *ring, ArenaType type, int generations);
+		Sets up <ring> with <generations> arenas of <type>, 2 up to
+		AR_RING_MAX. Data lives for <generations> - 1 advances: with
+		2, frame N can read what frame N - 1 built.
+
+		Returns:
+		- 0 on success.
+		- -1 on failure, <ring> holds no arenas.
+
+	Arena *arring_advance(ArenaRing *ring);
+		Moves to the next generation: the oldest arena is reset with
+		ring->policy (AR_RESET_KEEP after arring_init) and becomes the
+		current one.
+
+		Returns:
+		- The new current arena.
+
+	Arena *arring_current(ArenaRing *ring);
+	Arena *arring_get(ArenaRing *ring, int age);
+		The current arena, and the one <age> advances old, NULL past
+		the ring's generations.
+
+	void arring_free(ArenaRing *ring);
+		Frees every arena of the ring.
+
+		Arena rings are caller-owned and not thread-safe, one thread
+		advances while others may read older generations.
+
+		ArenaRing frames;
+		arring_init(&frames, AR_DYNAMIC, 2);
+		for (;;) {
+			Arena *frame = arring_advance(&frames);
+			State *prev = last_state;         // in arring_get(&frames, 1)
+			last_state = update(frame, prev);
+		}
+
+	### C++
+	template <class T> class ArenaAllocator;
+		STL allocator, ArenaAllocator<T>(arena). Usable with every
+		standard, pre-C++11 included.
+
+	class ArenaResource : public std::pmr::memory_resource;
+		ArenaResource(arena), C++17 and up. do_allocate forwards to
+		aralloc_aligned, honoring the requested alignment. A resource
+		only compares equal to itself, and builds with -fno-rtti.
+
+		Arena *arena = arinit(AR_DYNAMIC);
+		ArenaResource resource(arena);
+		std::pmr::vector<std::pmr::string> names(&resource);
+
+	Notes:
+	- Both throw std::bad_alloc when the arena is out of memory.
+	- deallocate is a no-op, memory comes back on arreset/arfree.
+	- Destroy the containers before the arena memory goes away.
+
+	template <size_t Bytes, size_t Align = 16> class StaticArena;
+		Bump allocator over a <Bytes> buffer held inline, on the stack
+		or in the enclosing object, aligned to <Align>. Capacity and
+		alignment are compile-time constants, mmap is only reached
+		once the buffer is full: the rest goes to an AR_DYNAMIC arena
+		made on first overflow.
+
+		void *alloc(size_t size);
+		void *alloc_aligned(size_t size, size_t align);
+			Like aralloc/aralloc_aligned, <Align>-byte aligned by
+			default. NULL on failure.
+
+		void reset();
+			Releases everything, arreset for the overflow arena.
+
+		size_t used() const;
+			Bytes taken from the buffer.
+
+		Arena *overflow() const;
+			The overflow arena, NULL until the buffer ran out.
+
+		StaticArena<4096> scratch;
+		char *line = (char *)scratch.alloc(len + 1);
+
+	Notes:
+	- Not copyable, the overflow arena is freed with the object.
+	- Not thread-safe.
+
+	### Tracing
+	ARENA_TRACE(event, arena, chunk)
+		Called on chunk and growth events, does nothing by default.
+		Define it before the implementation to feed your own tracing:
+
+		#define ARENA_TRACE(ev, a, c) my_probe((int)(ev), (c)->capacity)
+		#define ARENA_IMPLEMENTATION
+		#include "arena.h"
+
+		<event> is an ArenaEvent, <arena> is NULL for chunk events that
+		happen outside an arena (mapping, unmapping, the chunk cache).
+
+	Notes:
+	- It runs inside the allocator, possibly with the cache lock held
+	  elsewhere: it must not allocate from an arena.
+
+	### Debugging
+	ARENA_DEBUG
+		Define it for the implementation and every ARENA_INLINE user
+		to check arena memory, aralloc_fast then goes through aralloc.
+		Without it none of this is compiled in.
+
+		- Each allocation gets a header canary in front and
+		  ARENA_REDZONE (16) canary bytes behind. arreset, arrewind and
+		  arfree check those of what they release, archeck all of them.
+		- Under AddressSanitizer headers, redzones, unallocated chunk
+		  memory and everything a reset or rewind releases are
+		  poisoned, so overruns and use after arreset are reported
+		  where they happen. Without it released memory is overwritten
+		  with 0xdd instead.
+		- Add AR_GUARD_PAGES to catch overruns past a chunk without
+		  AddressSanitizer.
+
+	int archeck(Arena* arena);
+		Checks the canaries of every allocation since the last reset.
+
+		Returns:
+		- 0 if all are intact, or without ARENA_DEBUG.
+		- -1 if one is damaged, after ARENA_DEBUG_FAIL ran for it.
+
+	ARENA_DEBUG_FAIL(arena, ptr)
+		Called with the allocation <ptr> whose canary is damaged,
+		__builtin_trap() by default. Define it before the
+		implementation to log and carry on instead.
+
+	Notes:
+	- Debug allocations cost a header plus the redzone, and
+	  arrealloc never resizes in place.
+	- aralloc_batch is one allocation, its objects share one redzone.
+	- Redzones count as padding in arstats.
+
+	### Profiling
+	ARENA_PROFILE
+		Define it for the implementation and every ARENA_INLINE user
+		to sample allocations by call site. Each thread counts down
+		the bytes it allocates, about every ARENA_PROFILE_INTERVAL
+		(512KB) one allocation records its stack (backtrace(3)) and
+		the thread's tag. The fast path only pays the countdown.
+
+		Samples are kept per arena in a table mapped on the first one,
+		and cleared by arreset/arreset_ex: they describe what the arena
+		holds since its last reset.
+
+	size_t arprof_interval(size_t bytes);
+		Sets the mean number of bytes between two samples.
+
+		Returns:
+		- The previous interval.
+
+		Notes:
+		- 0 stops sampling, threads pick a change up at their next
+		  sample.
+
+	const char *arprof_tag(const char *tag);
+		Tags the calling thread's samples with <tag>, NULL for none.
+		<tag> is kept as a pointer and must outlive the profile.
+
+		Returns:
+		- The previous tag, to restore when a tagged scope ends.
+
+	int arprof_write(Arena* arena, int fd, ArenaProfileFormat format);
+		Writes the samples of <arena> to <fd>.
+
+		Parameters:
+		- format: AR_PROFILE_PPROF for the legacy heap profile text
+		  pprof reads (addresses, /proc/self/maps appended for it to
+		  symbolize), AR_PROFILE_FOLDED for one "tag;frame;...;frame
+		  bytes" line per site, the input of flamegraph.pl
+
+		Returns:
+		- 0 on success, -1 on failure or without ARENA_PROFILE.
+
+		int fd = open("arena.prof", O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		arprof_write(arena, fd, AR_PROFILE_PPROF);
+		// pprof -top ./server arena.prof
+
+	Notes:
+	- Bytes are estimates: a sample stands for the interval, or for
+	  its own size when it's larger.
+	- Frames are return addresses, leaf first in pprof profiles and
+	  root first in folded ones, the allocator's own frames included.
+	- Sites past ARENA_PROFILE_SITES (1024) only add to a
+	  "[dropped]" total. arrewind doesn't drop samples.
+
     USAGE:
     	Do this: #define ARENA_IMPLEMENTATION
     	before you include this file in *one* C or C++ file
@@ -85,8 +708,11 @@
     ..
 	Arena *arena = arinit(AR_FIXED); // or Arena *arena = arinit(AR_DYNAMIC)
 	struct my_struct *new_struct = aralloc(arena, sizeof(my_struct));
-	arfree(arena);
+	ArenaMark mark = armark(arena);
+	char *scratch = aralloc(arena, 1024);
+	arrewind(arena, mark); // scratch is released
 	arreset(arena);
+	arfree(arena);
 
     LICENSE: See end of file for license information.
 */
@@ -109,181 +735,3201 @@ typedef struct Arena Arena;
 typedef enum {
 	AR_FIXED,
 	AR_DYNAMIC,
+	AR_VIRTUAL,
+	AR_SHARED,
 } ArenaType;
 
+// position in an arena, see armark/arrewind
+typedef struct {
+	struct Chunk *chunk;
+	size_t offset;
+	size_t requested; // ARENA_STATS counter to restore
+	struct ArenaDebug *debug; // ARENA_DEBUG allocations to keep
+	struct Chunk *large; // newest large allocation to keep
+} ArenaMark;
+
+// see arstats, fields marked * are counted with ARENA_STATS only, 0 otherwise
+typedef struct {
+	size_t allocated;  // bytes taken from chunks, padding included
+	size_t requested;  // * bytes asked for since the last reset
+	size_t padding;    // * alignment padding since the last reset
+	size_t committed;  // usable chunk bytes
+	size_t chunks;     // chunks held
+	size_t wasted;     // unused tails of the chunks before curr
+	size_t peak;       // * most bytes allocated at once
+	size_t expansions; // * chunks mapped and AR_VIRTUAL commits
+	size_t resets;     // * arreset/arreset_ex calls
+} ArenaStats;
+
+// what arreset_ex does with the memory it no longer needs
+typedef enum {
+	AR_RESET_KEEP,     // keep every chunk, like arreset
+	AR_RESET_TRIM,     // keep the first <keep> bytes of chunks, unmap the rest
+	AR_RESET_FREE,     // keep every chunk, MADV_FREE pages past <keep> bytes
+	AR_RESET_ADAPTIVE, // AR_RESET_TRIM to what recent resets needed
+	AR_RESET_COALESCE, // replace the chunks by a single one of their size
+} ArenaResetMode;
+
+typedef struct {
+	ArenaResetMode mode;
+	size_t keep;
+} ArenaResetPolicy;
+
+// arinit_ex parameters, zero fields pick the arinit defaults
+typedef struct {
+	ArenaType type;       // backend
+	size_t initial_size;  // first chunk (AR_VIRTUAL: first commit)
+	size_t growth_factor; // next chunk = previous * factor, default 2
+	size_t growth_step;   // if set, next chunk = previous + step instead
+	size_t max_size;      // limit on chunk bytes (AR_VIRTUAL: reservation)
+	unsigned flags;       // AR_HUGEPAGES | AR_PREFAULT | AR_NUMA_* | AR_GUARD_PAGES | AR_REFILL
+	int numa_node;        // node for AR_NUMA_BIND
+	size_t large_size;    // own mappings from this size, 0: past the next chunk
+	unsigned refill_percent; // AR_REFILL threshold, 75 if 0
+} ArenaConfig;
+
+// arprof_write output
+typedef enum {
+	AR_PROFILE_PPROF,  // legacy pprof heap profile
+	AR_PROFILE_FOLDED, // folded stacks, for flamegraph.pl
+} ArenaProfileFormat;
+
+// ARENA_TRACE events
+typedef enum {
+	AR_EVENT_MAP,       // chunk mapped from the kernel
+	AR_EVENT_UNMAP,     // chunk unmapped
+	AR_EVENT_CACHE_HIT, // chunk taken from the chunk cache
+	AR_EVENT_CACHE_PUT, // chunk handed to the chunk cache
+	AR_EVENT_COMMIT,    // AR_VIRTUAL pages committed
+	AR_EVENT_GROW,      // arena linked a new chunk
+	AR_EVENT_RESET,     // arreset/arreset_ex, chunk is the head
+} ArenaEvent;
+
+// ArenaConfig flags
+#define AR_HUGEPAGES 0x1u // back chunks of 2MB and more with huge pages
+#define AR_PREFAULT  0x2u // fault in chunk memory when it is mapped
+#define AR_READONLY  0x4u // arinit_file: map the file without writing it
+#define AR_NUMA_BIND  0x8u // bind chunk memory to config->numa_node
+#define AR_NUMA_LOCAL 0x10u // bind it to the node of the thread calling arinit
+#define AR_GUARD_PAGES 0x20u // put a PROT_NONE page after every chunk
+#define AR_REFILL 0x40u // map the next AR_DYNAMIC chunk ahead on a helper thread
+
 // Public API declarations
 struct Arena *arinit(ArenaType type);
+struct Arena *arinit_ex(const ArenaConfig *config);
 void arfree(Arena* arena);
 void* aralloc(Arena* arena, size_t size);
+void* aralloc_aligned(Arena* arena, size_t size, size_t align);
+void* aralloc_slow(Arena* arena, size_t size, size_t align);
+void* aralloc_batch(Arena* arena, size_t size, size_t count, void **out);
+void* arcalloc(Arena* arena, size_t count, size_t size);
 void arreset(Arena* arena);
+void arreset_ex(Arena* arena, ArenaResetPolicy policy);
+ArenaMark armark(Arena* arena);
+void arrewind(Arena* arena, ArenaMark mark);
+Arena *arthread_local(ArenaType type);
+void arthread_release(ArenaType type);
+void arthread_purge(void);
+void arthread_numa(int enable);
+size_t arcache_limit(size_t bytes);
+void arcache_purge(void);
+size_t arhuge_bytes(Arena* arena);
+int arstats(Arena* arena, ArenaStats *stats);
+int archeck(Arena* arena);
+size_t arprof_interval(size_t bytes);
+const char *arprof_tag(const char *tag);
+int arprof_write(Arena* arena, int fd, ArenaProfileFormat format);
+Arena* arinit_file(const char *path, size_t capacity, unsigned flags);
+int arsync(Arena* arena);
+size_t aroffset(Arena* arena, const void *ptr);
+void* arptr(Arena* arena, size_t offset);
+int arroot_set(Arena* arena, const void *ptr);
+void* arroot_get(Arena* arena);
+void* arrealloc(Arena* arena, void *old, size_t old_size, size_t new_size);
+int arreserve(Arena* arena, size_t size);
+
+// Arena-backed containers, growth goes through arrealloc
+#define ArenaVec(T) struct { T *data; size_t len; size_t cap; }
+
+#define arvec_reserve(arena, vec, n) \
+	((n) <= (vec)->cap ? 0 : \
+	 arvec_grow((arena), &(vec)->data, &(vec)->cap, (n), sizeof(*(vec)->data)))
+#define arvec_push(arena, vec, value) \
+	(arvec_reserve((arena), (vec), (vec)->len + 1) == 0 ? \
+	 ((vec)->data[(vec)->len++] = (value), 0) : -1)
+#define arvec_pop(vec) ((vec)->data[--(vec)->len])
+#define arvec_clear(vec) ((vec)->len = 0)
+
+typedef struct {
+	char *data; // NUL terminated once anything was appended
+	size_t len;
+	size_t cap;
+} ArenaStr;
+
+int arvec_grow(Arena* arena, void *data, size_t *cap, size_t need, size_t elem_size);
+int arstr_append(Arena* arena, ArenaStr *str, const char *src, size_t n);
+int arstr_puts(Arena* arena, ArenaStr *str, const char *src);
+int arstr_putc(Arena* arena, ArenaStr *str, char c);
+
+// fixed-size object pool carved from an arena
+typedef struct ArenaPool ArenaPool;
+
+ArenaPool *arpool_init(Arena* arena, size_t obj_size);
+void *arpool_alloc(ArenaPool *pool);
+void arpool_free(ArenaPool *pool, void *obj);
+
+// generations an ArenaRing can hold
+#define AR_RING_MAX 8
+
+// caller-owned ring of arenas, see arring_init
+typedef struct {
+	Arena *arenas[AR_RING_MAX];
+	int generations;
+	int current;
+	ArenaResetPolicy policy; // applied to the arena arring_advance reuses
+} ArenaRing;
+
+int arring_init(ArenaRing *ring, ArenaType type, int generations);
+Arena *arring_advance(ArenaRing *ring);
+Arena *arring_current(ArenaRing *ring);
+Arena *arring_get(ArenaRing *ring, int age);
+void arring_free(ArenaRing *ring);
 
 #ifdef __cplusplus
 }
 #endif
 
-#endif // ARENA_H
-
-// ============================================
-//           IMPLEMENTATION SECTION
-// ============================================
+// ============================
+//         C++ ADAPTERS
+// ============================
 
-#ifdef ARENA_IMPLEMENTATION
+#ifdef __cplusplus
 
-#include <sys/mman.h>
-#include <stdlib.h>
-#include <stdio.h>
+#include <new>
 
-#define PAGE_SIZE 4096
+// STL allocator drawing from an Arena, deallocate is a no-op.
+// Works with pre-C++11 containers, which need the full typedef set.
+template <class T>
+class ArenaAllocator {
+public:
+	typedef T value_type;
+	typedef T* pointer;
+	typedef const T* const_pointer;
+	typedef T& reference;
+	typedef const T& const_reference;
+	typedef size_t size_type;
+	typedef ptrdiff_t difference_type;
 
-// ensures every arena allocation is a multiple of 16 bytes
-#define AR_ALIGN 16
-#define AR_ALIGN_UP(n) (((n) + AR_ALIGN -1) & ~(AR_ALIGN - 1))
+	template <class U> struct rebind { typedef ArenaAllocator<U> other; };
 
-// ==========================================
-// 		CHUNK HANDLING
-// ==========================================
+	explicit ArenaAllocator(Arena *arena) throw() : arena_(arena) {}
 
-struct Chunk {
-	char *memory;
-	size_t capacity;
-	size_t offset;
-	struct Chunk *next;
-};
+	template <class U>
+	ArenaAllocator(const ArenaAllocator<U> &other) throw() : arena_(other.arena()) {}
 
-struct Chunk *chunk_init(ArenaType type, size_t size) {
-	if (type != AR_FIXED && type != AR_DYNAMIC) return NULL;
+	Arena *arena() const throw() { return arena_; }
 
-	struct Chunk* new_chunk = malloc(sizeof(struct Chunk));
+	pointer allocate(size_type n, const void * = 0) {
+		if (n > max_size()) throw std::bad_alloc();
 
-	// can't allocate memory chunk
-	if (!new_chunk) return NULL;
+		void *ptr = aralloc_aligned(arena_, n * sizeof(T), __alignof__(T));
 
-	new_chunk->memory = mmap(NULL, size,
-                        	PROT_READ | PROT_WRITE,
-                        	MAP_PRIVATE | MAP_ANONYMOUS,
-                        	-1, 0);
+		if (!ptr) throw std::bad_alloc();
 
-	// new chunk has no memory, raise nomem error
-	if (new_chunk->memory == MAP_FAILED) {
-		free(new_chunk);
-		return NULL;
+		return static_cast<pointer>(ptr);
 	}
 
-	new_chunk->capacity = size;
-	new_chunk->offset = 0;
-	new_chunk->next = NULL;
+	void deallocate(pointer, size_type) throw() {}
 
-	printf("Allocated new Chunk w/ capacity %ld\n", new_chunk->capacity);
-	return new_chunk;
-}
+	size_type max_size() const throw() { return (size_type)-1 / sizeof(T); }
 
-void chunk_destroy (struct Chunk *chunk) {
-	munmap(chunk->memory, chunk->capacity);
-	free(chunk);
-}
-// CHUNK HANDLING
+	pointer address(reference x) const { return &x; }
+	const_pointer address(const_reference x) const { return &x; }
 
+	void construct(pointer p, const T &value) { new ((void *)p) T(value); }
+	void destroy(pointer p) { p->~T(); }
 
-// ==========================================
-// 		ARENA HANDLING
-// ==========================================
-struct Arena {
-	ArenaType type;
-    struct Chunk *head;
-    struct Chunk *curr;
+private:
+	Arena *arena_;
 };
 
-struct Arena *arinit (ArenaType type) {
-	if (type != AR_FIXED && type != AR_DYNAMIC) return NULL;
+template <class T, class U>
+bool operator==(const ArenaAllocator<T> &a, const ArenaAllocator<U> &b) throw() {
+	return a.arena() == b.arena();
+}
 
-	struct Arena *new_arena = malloc(sizeof(struct Arena));
+template <class T, class U>
+bool operator!=(const ArenaAllocator<T> &a, const ArenaAllocator<U> &b) throw() {
+	return a.arena() != b.arena();
+}
 
-	if (!new_arena) return NULL;
+// Bump allocation from an inline buffer of <Bytes>, spilling to a
+// dynamic arena once it's full
+template <size_t Bytes, size_t Align = 16>
+class StaticArena {
+	// <Align> must be a power of two, <Bytes> can't be 0
+	typedef char align_check[(Align & (Align - 1)) == 0 ? 1 : -1];
+	typedef char bytes_check[Bytes > 0 ? 1 : -1];
 
-	new_arena->type = type;
+public:
+	StaticArena() throw() : offset_(0), overflow_(0) {}
 
-	size_t init_size = (type == AR_FIXED) ? PAGE_SIZE * 16 : PAGE_SIZE;
+	~StaticArena() { arfree(overflow_); }
 
-	new_arena->head = new_arena->curr = chunk_init(type, init_size);
+	void *alloc(size_t size) {
+		size_t start = (offset_ + Align - 1) & ~(Align - 1);
 
-	if (!new_arena->head) {
-		free(new_arena);
-		return NULL;
+		if (size <= Bytes && start <= Bytes - size) {
+			offset_ = start + size;
+			return buf_ + start;
+		}
+
+		return spill(size, Align);
 	}
 
-	return new_arena;
-}
+	void *alloc_aligned(size_t size, size_t align) {
+		if (align == 0 || (align & (align - 1)) != 0) return 0;
+		if (align <= Align) return alloc(size);
 
-void arfree(Arena* arena) {
-	struct Chunk *cursor = arena->head;
+		size_t addr = (size_t)(buf_ + offset_);
+		size_t start = offset_ + (-addr & (align - 1));
 
-	while (cursor->next != NULL) {
-		chunk_destroy(cursor);
+		if (size <= Bytes && start <= Bytes - size) {
+			offset_ = start + size;
+			return buf_ + start;
+		}
 
-		cursor=cursor->next;
+		return spill(size, align);
 	}
-	chunk_destroy(cursor);
-	free(arena);
-}
 
-void *aralloc(Arena* arena, size_t size) {
-	if (!arena) return NULL;
+	void reset() {
+		offset_ = 0;
+		if (overflow_) arreset(overflow_);
+	}
 
-	size = AR_ALIGN_UP(size);
+	size_t used() const { return offset_; }
 
-	if (arena->curr->offset + size <= arena->curr->capacity) {
-		void *ptr = arena->curr->memory + arena->curr->offset;
-		arena->curr->offset += size;
+	Arena *overflow() const { return overflow_; }
 
-		return ptr;
+private:
+	StaticArena(const StaticArena &);
+	StaticArena &operator=(const StaticArena &);
+
+	void *spill(size_t size, size_t align) {
+		if (!overflow_) overflow_ = arinit(AR_DYNAMIC);
+		if (!overflow_) return 0;
+
+		return aralloc_aligned(overflow_, size, align);
 	}
 
-	// Not enough space in chunk
-	if (arena->type == AR_FIXED) return NULL;
+	char buf_[Bytes] __attribute__((aligned(Align)));
+	size_t offset_;
+	Arena *overflow_;
+};
 
-	if (arena->type == AR_DYNAMIC) {
-		size_t next_size = arena->curr->capacity * 2;
+#if __cplusplus >= 201703L && defined(__has_include)
+#if __has_include(<memory_resource>)
 
-		if (next_size < size) {
-			next_size = AR_ALIGN_UP(size);
-		}
+#include <memory_resource>
 
-		struct Chunk* new_chunk = chunk_init(AR_DYNAMIC, next_size);
+// std::pmr::memory_resource over an Arena, deallocation is a no-op
+class ArenaResource : public std::pmr::memory_resource {
+public:
+	explicit ArenaResource(Arena *arena) noexcept : arena_(arena) {}
 
-		if(!new_chunk) return NULL;
+	Arena *arena() const noexcept { return arena_; }
+
+private:
+	void *do_allocate(size_t bytes, size_t align) override {
+		void *ptr = aralloc_aligned(arena_, bytes, align);
 
-		arena->curr->next = new_chunk;
-		arena->curr = arena->curr->next;
+		if (!ptr) throw std::bad_alloc();
 
-		void *ptr = arena->curr->memory + arena->curr->offset;
-		arena->curr->offset += size;
 		return ptr;
 	}
 
-	return NULL;
-}
-
-void arreset(Arena* arena) {
-	if (!arena) return;
+	void do_deallocate(void *, size_t, size_t) override {}
 
-	if (arena->type == AR_FIXED) {
-		arena->head->offset = 0;
-		return;
+	// no dynamic_cast, arena.h builds with -fno-rtti
+	bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override {
+		return this == &other;
 	}
 
-	if(arena->type == AR_DYNAMIC) {
-		struct Chunk *curr = arena->head;
-		while (curr) {
-			curr->offset =0;
-			curr = curr->next;
-		}
+	Arena *arena_;
+};
 
-		arena->curr = arena->head;
-		return;
-	}
+#endif // __has_include(<memory_resource>)
+#endif // C++17
+
+#endif // __cplusplus
+
+#endif // ARENA_H
+
+// ============================================
+//        STRUCT SECTION (ARENA_INLINE)
+// ============================================
+
+// Struct layouts are private unless ARENA_INLINE is defined, every
+// translation unit sees the same definitions either way.
+#if (defined(ARENA_INLINE) || defined(ARENA_IMPLEMENTATION)) && !defined(ARENA_STRUCTS)
+#define ARENA_STRUCTS
+
+// counter updates for arstats
+#ifdef ARENA_STATS
+#define AR_STAT(x) x
+#else
+#define AR_STAT(x) ((void)0)
+#endif
+
+// ARENA_PROFILE countdown, see ar_profile_sample
+#ifdef ARENA_PROFILE
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern __thread size_t ar_sample_left;
+void *ar_profile_sample(Arena *arena, size_t size, void *ptr);
+
+#ifdef __cplusplus
 }
+#endif
 
-// ARENA HANDLING
+// evaluates to <ptr>, the sample is a tail call
+#define AR_SAMPLE(arena, size, ptr) \
+	((size) < ar_sample_left ? (ar_sample_left -= (size), (ptr)) : \
+	 ar_profile_sample((arena), (size), (ptr)))
+#else
+#define AR_SAMPLE(arena, size, ptr) (ptr)
+#endif
+
+// resets remembered by AR_RESET_ADAPTIVE
+#define AR_USAGE_WINDOW 16
+
+// default alignment of arena allocations.
+// Chunk memory is AR_ALIGN aligned and capacities are a multiple of it.
+#define AR_ALIGN 16
+#define AR_ALIGN_UP(n) (((n) + AR_ALIGN -1) & ~(AR_ALIGN - 1))
+
+// memory, offset and capacity are read on every allocation: they come
+// first and chunk headers are cache line aligned, so they share a line.
+struct Chunk {
+	char *memory;
+	size_t offset;
+	size_t capacity; // usable (committed) bytes
+	size_t reserved; // bytes of address space mapped at memory
+	struct Chunk *next;
+	unsigned flags;
+	size_t dirty; // bytes past max(offset, dirty) are still zero
+};
+
+struct Arena {
+	struct Chunk *curr;
+	ArenaType type;
+	struct Chunk *head;
+	struct Arena *idle_next; // link in the idle list of arthread_local
+	int lock; // AR_SHARED growth lock
+	size_t growth_factor;
+	size_t growth_step;
+	size_t max_size;
+	size_t large_size; // ArenaConfig.large_size
+	struct Chunk *large; // large allocations, newest first
+	size_t total; // bytes of chunk memory held
+	unsigned flags; // ArenaConfig flags
+	int numa_node; // node chunks are bound to, -1 for none
+	size_t usage[AR_USAGE_WINDOW]; // arena_footprint at the last resets
+	unsigned usage_next;
+	unsigned usage_count;
+	// ARENA_STATS counters, kept in either build so the layout matches
+	size_t requested;
+	size_t peak;
+	size_t expansions;
+	size_t resets;
+	struct ArenaDebug *debug; // ARENA_DEBUG allocations, newest first
+	struct ArenaProfile *profile; // ARENA_PROFILE samples, mapped on the first
+	// AR_REFILL
+	unsigned refill_percent;
+	struct Chunk *refill_chunk; // curr, its capacity cut to the threshold
+	size_t refill_capacity; // its real capacity
+	size_t refill_span; // mapping size asked of the helper
+	int refill_pending; // queued or being mapped, under ar_refill_mutex
+	struct Arena *refill_next; // link in the helper's queue
+	struct Chunk *spare; // chunk the helper mapped, taken by chunk_next
+};
+
+#endif // ARENA_STRUCTS
+
+#if defined(ARENA_INLINE) && !defined(ARENA_INLINE_H)
+#define ARENA_INLINE_H
+
+// Bump allocation from the current chunk, growth is left to aralloc_slow.
+// Unlike aralloc, <arena> must not be NULL.
+static inline void *aralloc_fast(Arena *arena, size_t size) {
+#ifdef ARENA_DEBUG
+	return aralloc(arena, size);
+#endif
+
+	// read-only file arenas take nothing, see arinit_file
+	if (arena->flags & AR_READONLY) return NULL;
+
+	struct Chunk *chunk = arena->curr;
+	size_t start = AR_ALIGN_UP(chunk->offset);
+
+	// start <= capacity, see AR_ALIGN
+	if (size <= chunk->capacity - start) {
+		chunk->offset = start + size;
+		AR_STAT(arena->requested += size);
+
+		return AR_SAMPLE(arena, size, chunk->memory + start);
+	}
+
+#ifdef ARENA_PROFILE
+	// aralloc samples the allocation, this stays a tail call
+	return aralloc(arena, size);
+#else
+	return aralloc_slow(arena, size, AR_ALIGN);
+#endif
+}
+
+#endif // ARENA_INLINE_H
+
+// ============================================
+//           IMPLEMENTATION SECTION
+// ============================================
+
+#ifdef ARENA_IMPLEMENTATION
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+
+#ifdef ARENA_PROFILE
+#include <execinfo.h>
+#endif
+
+// what mmap, mprotect and madvise align to, see ar_page_size
+#define AR_PAGE_SIZE ar_page_size()
+#define AR_CACHE_LINE 64
+
+// number of ArenaType values
+#define AR_NTYPES 4
+
+// address space reserved by an AR_VIRTUAL arena
+#ifndef AR_VIRTUAL_RESERVE
+#define AR_VIRTUAL_RESERVE ((size_t)8 << 30)
+#endif
+#define AR_PAGE_UP(n) (((n) + AR_PAGE_SIZE - 1) & ~((size_t)AR_PAGE_SIZE - 1))
+
+#define AR_HUGE_PAGE ((size_t)2 << 20)
+#define AR_HUGE_UP(n) (((n) + AR_HUGE_PAGE - 1) & ~(AR_HUGE_PAGE - 1))
+
+// struct Chunk flags
+#define AR_CHUNK_HUGETLB 1u // backed by MAP_HUGETLB pages
+#define AR_CHUNK_FILE    2u // maps a file, see arinit_file
+#define AR_CHUNK_NUMA    4u // has a NUMA memory policy
+#define AR_CHUNK_GUARD   8u // followed by a PROT_NONE page
+#define AR_CHUNK_STALE  16u // cached with its old pages, madvise failed
+
+// bytes of freed chunks kept mapped for reuse, see arcache_limit
+#ifndef ARENA_CACHE_MAX
+#define ARENA_CACHE_MAX ((size_t)64 << 20)
+#endif
+
+// how cached chunks give their pages back to the kernel
+#ifndef ARENA_CACHE_ADVICE
+#define ARENA_CACHE_ADVICE MADV_DONTNEED
+#endif
+
+// event hook, see ARENA_TRACE in the docs
+#ifndef ARENA_TRACE
+#define ARENA_TRACE(event, arena, chunk) ((void)0)
+#endif
+
+// ARENA_DEBUG, see the docs
+#ifndef ARENA_REDZONE
+#define ARENA_REDZONE 16
+#endif
+
+#ifndef ARENA_DEBUG_FAIL
+#define ARENA_DEBUG_FAIL(arena, ptr) __builtin_trap()
+#endif
+
+#if defined(ARENA_DEBUG) && defined(__SANITIZE_ADDRESS__)
+#define AR_ASAN 1
+#elif defined(ARENA_DEBUG) && defined(__has_feature)
+#if __has_feature(address_sanitizer)
+#define AR_ASAN 1
+#endif
+#endif
+
+#ifdef AR_ASAN
+#include <sanitizer/asan_interface.h>
+#define AR_POISON(p, n) ASAN_POISON_MEMORY_REGION(p, n)
+#define AR_UNPOISON(p, n) ASAN_UNPOISON_MEMORY_REGION(p, n)
+#define AR_NO_ASAN __attribute__((no_sanitize_address))
+#else
+#define AR_POISON(p, n) ((void)0)
+#define AR_UNPOISON(p, n) ((void)0)
+#define AR_NO_ASAN
+#endif
+
+// memory a reset or rewind hands back
+#if defined(AR_ASAN)
+#define AR_RELEASED(p, n) AR_POISON(p, n)
+#elif defined(ARENA_DEBUG)
+#define AR_RELEASED(p, n) memset(p, 0xdd, n)
+#else
+#define AR_RELEASED(p, n) ((void)0)
+#endif
+
+// spinlock for short critical sections
+void ar_lock(int *lock) {
+	while (__atomic_exchange_n(lock, 1, __ATOMIC_ACQUIRE)) {
+		while (__atomic_load_n(lock, __ATOMIC_RELAXED)) sched_yield();
+	}
+}
+
+void ar_unlock(int *lock) {
+	__atomic_store_n(lock, 0, __ATOMIC_RELEASE);
+}
+
+static size_t ar_page_bytes;
+
+// the kernel's page size, read once
+size_t ar_page_size(void) {
+	size_t size = __atomic_load_n(&ar_page_bytes, __ATOMIC_RELAXED);
+
+	if (!size) {
+		long ret = sysconf(_SC_PAGESIZE);
+
+		size = ret > 0 ? (size_t)ret : 4096;
+		__atomic_store_n(&ar_page_bytes, size, __ATOMIC_RELAXED);
+	}
+
+	return size;
+}
+
+// ==========================================
+// 		CHUNK HANDLING
+// ==========================================
+
+// A chunk's header sits at the start of its own mapping, the first
+// chunk of an arena holds the Arena right after it. Each takes whole
+// cache lines, so memory starts on one.
+#define AR_LINE_UP(n) (((n) + AR_CACHE_LINE - 1) & ~((size_t)AR_CACHE_LINE - 1))
+#define AR_CHUNK_HDR AR_LINE_UP(sizeof(struct Chunk))
+#define AR_ARENA_HDR AR_LINE_UP(sizeof(struct Arena))
+
+// bytes mapped at <chunk>, headers and guard page included
+size_t chunk_span(struct Chunk *chunk) {
+	size_t span = (size_t)(chunk->memory - (char *)chunk) + chunk->reserved;
+
+	if (chunk->flags & AR_CHUNK_GUARD) span = AR_PAGE_UP(span) + AR_PAGE_SIZE;
+
+	return span;
+}
+
+// writes the header of a chunk over <span> bytes mapped at <map>
+struct Chunk *chunk_place(char *map, size_t span, size_t capacity) {
+	struct Chunk *chunk = (struct Chunk *)map;
+
+	chunk->memory = map + AR_CHUNK_HDR;
+	chunk->offset = 0;
+	chunk->capacity = capacity;
+	chunk->reserved = span - AR_CHUNK_HDR;
+	chunk->next = NULL;
+	chunk->flags = 0;
+	chunk->dirty = 0;
+
+	return chunk;
+}
+
+// moves the offset back to <offset>, remembering how far the chunk was used
+void chunk_rewind(struct Chunk *chunk, size_t offset) {
+	size_t used = chunk->offset < chunk->capacity ? chunk->offset : chunk->capacity;
+
+	if (used > chunk->dirty) chunk->dirty = used;
+	if (used > offset) AR_RELEASED(chunk->memory + offset, used - offset);
+
+	chunk->offset = offset;
+}
+
+void chunk_destroy (struct Chunk *chunk) {
+	ARENA_TRACE(AR_EVENT_UNMAP, NULL, chunk);
+	// nothing past capacity is poisoned, see arena_trim
+	AR_UNPOISON(chunk, (size_t)(chunk->memory - (char *)chunk) + chunk->capacity);
+	munmap(chunk, chunk_span(chunk));
+}
+
+// ------------------------------------------
+// NUMA: memory policies are set with the raw syscalls, no libnuma.
+// Nodes up to AR_NUMA_NODES - 1 fit the one word node mask.
+// ------------------------------------------
+
+#ifndef MPOL_DEFAULT
+#define MPOL_DEFAULT 0
+#endif
+#ifndef MPOL_BIND
+#define MPOL_BIND 2
+#endif
+#ifndef MPOL_MF_MOVE
+#define MPOL_MF_MOVE (1 << 1)
+#endif
+
+#define AR_NUMA_NODES 64
+
+// node of the calling thread's cpu, -1 if unknown
+int ar_numa_node(void) {
+#ifdef SYS_getcpu
+	unsigned cpu, node;
+
+	if (syscall(SYS_getcpu, &cpu, &node, NULL) == 0 && node < AR_NUMA_NODES)
+		return (int)node;
+#endif
+	return -1;
+}
+
+// binds the pages of <chunk> to <node>, moving those already there,
+// or back to the default policy for -1
+int chunk_bind(struct Chunk *chunk, int node) {
+	if (node < 0 && !(chunk->flags & AR_CHUNK_NUMA)) return 0;
+	if (node >= AR_NUMA_NODES) return -1;
+
+#ifdef SYS_mbind
+	unsigned long mask = node < 0 ? 0 : 1ul << node;
+	long ret;
+
+	// the kernel reads one bit less than maxnode
+	if (node < 0)
+		ret = syscall(SYS_mbind, (void *)chunk, chunk_span(chunk), MPOL_DEFAULT,
+			      NULL, 0ul, 0u);
+	else
+		ret = syscall(SYS_mbind, (void *)chunk, chunk_span(chunk), MPOL_BIND,
+			      &mask, (unsigned long)AR_NUMA_NODES + 1, (unsigned)MPOL_MF_MOVE);
+
+	if (ret != 0) return -1;
+
+	if (node < 0) chunk->flags &= ~AR_CHUNK_NUMA;
+	else chunk->flags |= AR_CHUNK_NUMA;
+
+	return 0;
+#else
+	return -1;
+#endif
+}
+
+// ------------------------------------------
+// Chunk cache: freed chunks stay mapped, with their pages released by
+// madvise, in buckets of power-of-two mapping size. Bucket i holds chunks
+// of [2^i, 2^(i+1)) bytes so any chunk in the bucket above a size fits it.
+// ------------------------------------------
+
+#define AR_CACHE_BUCKETS (sizeof(size_t) * 8)
+
+static struct Chunk *ar_cache[AR_CACHE_BUCKETS];
+static size_t ar_cache_bytes;
+static size_t ar_cache_max = ARENA_CACHE_MAX;
+static int ar_cache_lock;
+
+// floor(log2(n)), n > 0
+unsigned chunk_bucket(size_t n) {
+	return (unsigned)(AR_CACHE_BUCKETS - 1 - __builtin_clzl(n));
+}
+
+// takes a cached chunk mapping at least <size> bytes, NULL if there is none
+struct Chunk *chunk_cache_take(size_t size) {
+	unsigned bucket = chunk_bucket(size);
+
+	if (((size_t)1 << bucket) < size) bucket++;
+
+	if (bucket >= AR_CACHE_BUCKETS) return NULL;
+
+	// larger buckets are left alone, it would waste more than 2x
+	ar_lock(&ar_cache_lock);
+
+	struct Chunk *chunk = ar_cache[bucket];
+
+	if (chunk) {
+		ar_cache[bucket] = chunk->next;
+		ar_cache_bytes -= chunk_span(chunk);
+	}
+
+	ar_unlock(&ar_cache_lock);
+
+	if (!chunk) return NULL;
+
+	// it may have held an arena, start over as a plain chunk
+	size_t span = chunk_span(chunk);
+	int clean = ARENA_CACHE_ADVICE == MADV_DONTNEED && !(chunk->flags & AR_CHUNK_STALE);
+
+	chunk_place((char *)chunk, span, span - AR_CHUNK_HDR);
+
+	chunk->dirty = clean ? 0 : chunk->capacity;
+
+	ARENA_TRACE(AR_EVENT_CACHE_HIT, NULL, chunk);
+	return chunk;
+}
+
+// hands a mapped chunk to the cache, destroys it above the high-water mark
+void chunk_release(struct Chunk *chunk) {
+	// guard pages don't fit the cache buckets, MAP_HUGETLB pages can't
+	// be given back below 2MB and are scarce
+	if (chunk->flags & (AR_CHUNK_GUARD | AR_CHUNK_HUGETLB)) {
+		chunk_destroy(chunk);
+		return;
+	}
+
+	size_t span = chunk_span(chunk);
+
+	AR_UNPOISON(chunk, span);
+
+	// all but the page holding the header, which is cleared by hand
+	if (span > AR_PAGE_SIZE &&
+	    madvise((char *)chunk + AR_PAGE_SIZE, span - AR_PAGE_SIZE, ARENA_CACHE_ADVICE) != 0)
+		chunk->flags |= AR_CHUNK_STALE;
+
+	if (ARENA_CACHE_ADVICE == MADV_DONTNEED)
+		memset((char *)chunk + AR_CHUNK_HDR, 0,
+		       (span < AR_PAGE_SIZE ? span : AR_PAGE_SIZE) - AR_CHUNK_HDR);
+
+	ARENA_TRACE(AR_EVENT_CACHE_PUT, NULL, chunk);
+
+	// the next arena to take it picks its own node
+	chunk_bind(chunk, -1);
+
+	ar_lock(&ar_cache_lock);
+
+	if (ar_cache_bytes + span <= ar_cache_max) {
+		unsigned bucket = chunk_bucket(span);
+
+		chunk->next = ar_cache[bucket];
+		ar_cache[bucket] = chunk;
+		ar_cache_bytes += span;
+		chunk = NULL;
+	}
+
+	ar_unlock(&ar_cache_lock);
+
+	if (chunk) chunk_destroy(chunk);
+}
+
+size_t arcache_limit(size_t bytes) {
+	struct Chunk *evicted = NULL;
+
+	ar_lock(&ar_cache_lock);
+
+	size_t prev = ar_cache_max;
+	ar_cache_max = bytes;
+
+	// evict from the largest buckets down to the new limit
+	for (unsigned i = AR_CACHE_BUCKETS; i-- > 0 && ar_cache_bytes > bytes;) {
+		while (ar_cache[i] && ar_cache_bytes > bytes) {
+			struct Chunk *chunk = ar_cache[i];
+
+			ar_cache[i] = chunk->next;
+			ar_cache_bytes -= chunk_span(chunk);
+			chunk->next = evicted;
+			evicted = chunk;
+		}
+	}
+
+	ar_unlock(&ar_cache_lock);
+
+	while (evicted) {
+		struct Chunk *next = evicted->next;
+		chunk_destroy(evicted);
+		evicted = next;
+	}
+
+	return prev;
+}
+
+void arcache_purge(void) {
+	arcache_limit(arcache_limit(0));
+}
+
+// maps <size> bytes aligned to <align>, trimming the excess of a larger map
+char *ar_map_aligned(size_t size, size_t align, int prot, int flags) {
+	char *map = mmap(NULL, size + align, prot, flags, -1, 0);
+
+	if (map == MAP_FAILED) return MAP_FAILED;
+
+	uintptr_t addr = (uintptr_t)map;
+	size_t head = (size_t)(-addr & (align - 1));
+
+	if (head) munmap(map, head);
+	munmap(map + head + size, align - head);
+
+	return map + head;
+}
+
+// faults in the pages under [memory, memory + size) for writing,
+// without changing their contents
+void ar_prefault(char *memory, size_t size) {
+	if (size == 0) return;
+
+	uintptr_t begin = (uintptr_t)memory & ~((uintptr_t)AR_PAGE_SIZE - 1);
+	uintptr_t end = AR_PAGE_UP((uintptr_t)memory + size);
+
+#ifdef MADV_POPULATE_WRITE
+	if (madvise((void *)begin, end - begin, MADV_POPULATE_WRITE) == 0) return;
+#endif
+
+	for (uintptr_t page = begin; page < end; page += AR_PAGE_SIZE) {
+		volatile char *byte = (volatile char *)page;
+		*byte = *byte;
+	}
+}
+
+// maps a fresh chunk of exactly <size> bytes, header included, bypassing
+// the cache. With AR_HUGEPAGES, huge page multiples try MAP_HUGETLB first
+// and fall back to transparent huge pages on an aligned mapping.
+// AR_GUARD_PAGES maps one more page past them and protects it.
+struct Chunk *chunk_map(size_t size, unsigned flags) {
+	if (size <= AR_CHUNK_HDR || size > (size_t)-1 - 2 * AR_PAGE_SIZE) return NULL;
+
+	if (flags & AR_GUARD_PAGES) {
+		char *map = mmap(NULL, AR_PAGE_UP(size) + AR_PAGE_SIZE,
+				 PROT_READ | PROT_WRITE,
+				 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+		if (map == MAP_FAILED) return NULL;
+
+		if (mprotect(map + AR_PAGE_UP(size), AR_PAGE_SIZE, PROT_NONE) != 0) {
+			munmap(map, AR_PAGE_UP(size) + AR_PAGE_SIZE);
+			return NULL;
+		}
+
+		struct Chunk *new_chunk = chunk_place(map, size, size - AR_CHUNK_HDR);
+
+		new_chunk->flags = AR_CHUNK_GUARD;
+
+		if (flags & AR_PREFAULT) ar_prefault(new_chunk->memory, new_chunk->capacity);
+
+		ARENA_TRACE(AR_EVENT_MAP, NULL, new_chunk);
+		return new_chunk;
+	}
+
+	int huge = (flags & AR_HUGEPAGES) && size % AR_HUGE_PAGE == 0;
+	int populate = 0;
+	unsigned chunk_flags = 0;
+	char *map = MAP_FAILED;
+
+#ifdef MAP_POPULATE
+	if (flags & AR_PREFAULT) populate = MAP_POPULATE;
+#endif
+
+#ifdef MAP_HUGETLB
+	if (huge) {
+		map = mmap(NULL, size,
+			   PROT_READ | PROT_WRITE,
+			   MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | populate,
+			   -1, 0);
+
+		if (map != MAP_FAILED) chunk_flags |= AR_CHUNK_HUGETLB;
+	}
+#endif
+
+#ifdef MADV_HUGEPAGE
+	if (huge && map == MAP_FAILED) {
+		map = ar_map_aligned(size, AR_HUGE_PAGE,
+				     PROT_READ | PROT_WRITE,
+				     MAP_PRIVATE | MAP_ANONYMOUS);
+
+		if (map != MAP_FAILED) {
+			madvise(map, size, MADV_HUGEPAGE);
+
+			if (flags & AR_PREFAULT) ar_prefault(map, size);
+		}
+	}
+#endif
+
+	if (map == MAP_FAILED)
+		map = mmap(NULL, size,
+			   PROT_READ | PROT_WRITE,
+			   MAP_PRIVATE | MAP_ANONYMOUS | populate,
+			   -1, 0);
+
+	// no memory, raise nomem error
+	if (map == MAP_FAILED) return NULL;
+
+	struct Chunk *new_chunk = chunk_place(map, size, size - AR_CHUNK_HDR);
+
+	new_chunk->flags = chunk_flags;
+
+	ARENA_TRACE(AR_EVENT_MAP, NULL, new_chunk);
+	return new_chunk;
+}
+
+struct Chunk *chunk_init(ArenaType type, size_t size, unsigned flags) {
+	if (type != AR_FIXED && type != AR_DYNAMIC && type != AR_SHARED)
+		return NULL;
+
+	if (size <= AR_CHUNK_HDR) return NULL;
+
+	// warm mapping from an earlier arfree, the cache doesn't sort by page size
+	if (!(flags & AR_GUARD_PAGES) && (!(flags & AR_HUGEPAGES) || size < AR_HUGE_PAGE)) {
+		struct Chunk* new_chunk = chunk_cache_take(size);
+
+		// its pages were given back to the kernel
+		if (new_chunk && (flags & AR_PREFAULT))
+			ar_prefault(new_chunk->memory, new_chunk->capacity);
+
+		if (new_chunk) return new_chunk;
+	}
+
+	return chunk_map(size, flags);
+}
+
+// a cached chunk may be larger than asked for: swaps <chunk> for a fresh
+// mapping of exactly <size> bytes if it has more than <limit> usable ones
+struct Chunk *chunk_map_exact(struct Chunk *chunk, size_t size, unsigned flags,
+			      size_t limit) {
+	if (!chunk || chunk->capacity <= limit) return chunk;
+
+	chunk_release(chunk);
+	return chunk_map(size, flags);
+}
+
+// chunk_init/chunk_map flags for a chunk bound to <node>: AR_PREFAULT
+// waits for chunk_bind_prefault, pages faulted in before mbind would
+// come from the mapping thread's node and get migrated
+unsigned chunk_numa_flags(unsigned flags, int node) {
+	return node >= 0 ? flags & ~AR_PREFAULT : flags;
+}
+
+// binds a chunk mapped with chunk_numa_flags to <node>, then faults it in
+int chunk_bind_prefault(struct Chunk *chunk, unsigned flags, int node) {
+	if (node < 0) return 0;
+
+	int ret = chunk_bind(chunk, node);
+
+	if (flags & AR_PREFAULT) ar_prefault(chunk->memory, chunk->capacity);
+
+	return ret;
+}
+
+// makes the first <size> bytes of a reserved chunk usable, memory +
+// capacity stays on a page boundary. Growth targets past the reservation
+// commit all of it, callers check that what they need fits.
+int chunk_commit(struct Chunk *chunk, size_t size, unsigned flags) {
+	if (size > chunk->reserved) size = chunk->reserved;
+	if (size <= chunk->capacity) return 0;
+
+	size_t head = (size_t)(chunk->memory - (char *)chunk);
+	size_t next_size = AR_PAGE_UP(head + size) - head;
+
+	if (next_size > chunk->reserved) next_size = chunk->reserved;
+
+	if (mprotect(chunk->memory + chunk->capacity,
+		     next_size - chunk->capacity,
+		     PROT_READ | PROT_WRITE) != 0) return -1;
+
+	if (flags & AR_PREFAULT)
+		ar_prefault(chunk->memory + chunk->capacity, next_size - chunk->capacity);
+
+	AR_POISON(chunk->memory + chunk->capacity, next_size - chunk->capacity);
+	chunk->capacity = next_size;
+
+	ARENA_TRACE(AR_EVENT_COMMIT, NULL, chunk);
+	return 0;
+}
+
+// reserves <reserve> bytes of address space, header included, commits
+// the first <commit> bytes past it.
+// AR_HUGEPAGES aligns the reservation and asks for transparent huge pages,
+// MAP_HUGETLB can't be committed page by page.
+struct Chunk *chunk_reserve(size_t reserve, size_t commit, unsigned flags) {
+	if (reserve < AR_PAGE_SIZE) return NULL;
+
+	int map_flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE;
+	char *map;
+
+	if (flags & AR_HUGEPAGES)
+		map = ar_map_aligned(reserve, AR_HUGE_PAGE, PROT_NONE, map_flags);
+	else
+		map = mmap(NULL, reserve, PROT_NONE, map_flags, -1, 0);
+
+	if (map == MAP_FAILED) return NULL;
+
+#ifdef MADV_HUGEPAGE
+	if (flags & AR_HUGEPAGES) madvise(map, reserve, MADV_HUGEPAGE);
+#endif
+
+	// the header page is always committed
+	if (mprotect(map, AR_PAGE_SIZE, PROT_READ | PROT_WRITE) != 0) {
+		munmap(map, reserve);
+		return NULL;
+	}
+
+	struct Chunk *new_chunk = chunk_place(map, reserve, AR_PAGE_SIZE - AR_CHUNK_HDR);
+
+	ARENA_TRACE(AR_EVENT_MAP, NULL, new_chunk);
+
+	if (chunk_commit(new_chunk, commit, flags) != 0) {
+		chunk_destroy(new_chunk);
+		return NULL;
+	}
+
+	return new_chunk;
+}
+
+// carves <size> bytes aligned to <align> from <chunk>, NULL if they don't fit
+void *chunk_bump(struct Chunk *chunk, size_t size, size_t align) {
+	uintptr_t addr = (uintptr_t)(chunk->memory + chunk->offset);
+	size_t pad = (size_t)(-addr & (align - 1));
+	size_t avail = chunk->capacity - chunk->offset;
+
+	if (pad > avail || size > avail - pad) return NULL;
+
+	chunk->offset += pad + size;
+	return (void *)(addr + pad);
+}
+
+// CHUNK HANDLING
+
+
+// ==========================================
+// 		ALLOCATION PROFILING
+// ==========================================
+
+// mean bytes between samples, see arprof_interval
+#ifndef ARENA_PROFILE_INTERVAL
+#define ARENA_PROFILE_INTERVAL ((size_t)512 << 10)
+#endif
+
+// call sites an arena profile can tell apart
+#ifndef ARENA_PROFILE_SITES
+#define ARENA_PROFILE_SITES 1024
+#endif
+
+// frames recorded per sample
+#ifndef ARENA_PROFILE_DEPTH
+#define ARENA_PROFILE_DEPTH 24
+#endif
+
+// countdown while sampling is off, to notice it turned back on
+#define AR_SAMPLE_IDLE ((size_t)64 << 20)
+
+struct ArenaSite {
+	unsigned gen; // the slot is empty unless it matches the profile's
+	int depth;
+	uint64_t hash;
+	const char *tag;
+	size_t count;
+	size_t bytes;
+	void *frames[ARENA_PROFILE_DEPTH];
+};
+
+// open addressing on the stack hash, reset by bumping gen
+struct ArenaProfile {
+	int lock; // AR_SHARED threads sample concurrently
+	unsigned gen;
+	size_t dropped;
+	struct ArenaSite sites[ARENA_PROFILE_SITES];
+};
+
+static size_t ar_sample_interval = ARENA_PROFILE_INTERVAL;
+static __thread const char *ar_sample_tag;
+
+size_t arprof_interval(size_t bytes) {
+	return __atomic_exchange_n(&ar_sample_interval, bytes, __ATOMIC_RELAXED);
+}
+
+const char *arprof_tag(const char *tag) {
+	const char *prev = ar_sample_tag;
+
+	ar_sample_tag = tag;
+	return prev;
+}
+
+// forgets the samples, called on reset
+void ar_profile_clear(Arena* arena) {
+	struct ArenaProfile *profile = arena->profile;
+
+	if (!profile) return;
+
+	ar_lock(&profile->lock);
+
+	// gen 0 is what empty mmap pages hold
+	if (++profile->gen == 0) {
+		memset(profile->sites, 0, sizeof(profile->sites));
+		profile->gen = 1;
+	}
+
+	profile->dropped = 0;
+	ar_unlock(&profile->lock);
+}
+
+void ar_profile_free(Arena* arena) {
+	if (arena->profile) munmap(arena->profile, sizeof(struct ArenaProfile));
+}
+
+#ifdef ARENA_PROFILE
+__thread size_t ar_sample_left;
+static __thread uint64_t ar_sample_seed;
+
+// bytes to the next sample, uniform in [interval / 2, interval * 3 / 2)
+// so allocation patterns can't line up with it
+size_t ar_sample_next(size_t interval) {
+	uint64_t x = ar_sample_seed;
+
+	// xorshift64
+	x ^= x << 13;
+	x ^= x >> 7;
+	x ^= x << 17;
+	ar_sample_seed = x;
+
+	return interval / 2 + (size_t)(x % interval);
+}
+
+struct ArenaProfile *ar_profile_map(Arena* arena) {
+	struct ArenaProfile *profile = __atomic_load_n(&arena->profile, __ATOMIC_ACQUIRE);
+
+	if (profile) return profile;
+
+	char *map = mmap(NULL, sizeof(struct ArenaProfile), PROT_READ | PROT_WRITE,
+			 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+	if (map == MAP_FAILED) return NULL;
+
+	profile = (struct ArenaProfile *)map;
+	profile->gen = 1;
+
+	// another thread of an AR_SHARED arena may have been first
+	struct ArenaProfile *seen = NULL;
+
+	if (!__atomic_compare_exchange_n(&arena->profile, &seen, profile, 0,
+					 __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+		munmap(map, sizeof(struct ArenaProfile));
+		return seen;
+	}
+
+	return profile;
+}
+
+// AR_SAMPLE ran out of countdown on the allocation of <size> bytes at
+// <ptr>, returns <ptr>
+__attribute__((noinline))
+void *ar_profile_sample(Arena* arena, size_t size, void *ptr) {
+	size_t interval = __atomic_load_n(&ar_sample_interval, __ATOMIC_RELAXED);
+	int first = ar_sample_seed == 0;
+
+	// a thread's first call only starts its countdown
+	if (first) ar_sample_seed = (uintptr_t)&ar_sample_seed | 1;
+
+	ar_sample_left = interval ? ar_sample_next(interval) : AR_SAMPLE_IDLE;
+
+	if (first || !interval) return ptr;
+
+	struct ArenaProfile *profile = ar_profile_map(arena);
+
+	if (!profile) return ptr;
+
+	// frame 0 is this function
+	void *trace[ARENA_PROFILE_DEPTH + 1];
+	int depth = backtrace(trace, ARENA_PROFILE_DEPTH + 1) - 1;
+	void **frames = trace + 1;
+
+	if (depth < 0) depth = 0;
+
+	const char *tag = ar_sample_tag;
+	size_t bytes = size > interval ? size : interval;
+
+	// FNV-1a over the frames and the tag
+	uint64_t hash = 0xcbf29ce484222325ull ^ (uintptr_t)tag;
+
+	for (int i = 0; i < depth; i++) {
+		hash ^= (uintptr_t)frames[i];
+		hash *= 0x100000001b3ull;
+	}
+
+	ar_lock(&profile->lock);
+
+	size_t slot = (size_t)(hash % ARENA_PROFILE_SITES);
+	struct ArenaSite *site = NULL;
+
+	for (size_t probe = 0; probe < ARENA_PROFILE_SITES; probe++) {
+		struct ArenaSite *s = &profile->sites[(slot + probe) % ARENA_PROFILE_SITES];
+
+		if (s->gen != profile->gen) {
+			s->gen = profile->gen;
+			s->depth = depth;
+			s->hash = hash;
+			s->tag = tag;
+			s->count = 0;
+			s->bytes = 0;
+			memcpy(s->frames, frames, sizeof(void *) * (size_t)depth);
+			site = s;
+			break;
+		}
+
+		if (s->hash == hash && s->tag == tag && s->depth == depth &&
+		    memcmp(s->frames, frames, sizeof(void *) * (size_t)depth) == 0) {
+			site = s;
+			break;
+		}
+	}
+
+	if (site) {
+		site->count++;
+		site->bytes += bytes;
+	} else {
+		profile->dropped += bytes;
+	}
+
+	ar_unlock(&profile->lock);
+	return ptr;
+}
+#endif
+
+// buffered write(2), no stdio
+struct ArenaWriter {
+	int fd;
+	int failed;
+	size_t len;
+	char buf[4096];
+};
+
+void ar_write_flush(struct ArenaWriter *w) {
+	size_t done = 0;
+
+	while (!w->failed && done < w->len) {
+		ssize_t n = write(w->fd, w->buf + done, w->len - done);
+
+		if (n > 0) done += (size_t)n;
+		else if (n < 0 && errno == EINTR) continue;
+		else w->failed = 1;
+	}
+
+	w->len = 0;
+}
+
+void ar_write(struct ArenaWriter *w, const char *src, size_t n) {
+	while (n) {
+		if (w->len == sizeof(w->buf)) ar_write_flush(w);
+
+		size_t room = sizeof(w->buf) - w->len;
+		size_t take = n < room ? n : room;
+
+		memcpy(w->buf + w->len, src, take);
+		w->len += take;
+		src += take;
+		n -= take;
+	}
+}
+
+void ar_write_str(struct ArenaWriter *w, const char *str) {
+	ar_write(w, str, strlen(str));
+}
+
+void ar_write_num(struct ArenaWriter *w, uint64_t value, unsigned base) {
+	char digits[24];
+	size_t n = 0;
+
+	do {
+		digits[sizeof(digits) - ++n] = "0123456789abcdef"[value % base];
+		value /= base;
+	} while (value);
+
+	if (base == 16) ar_write(w, "0x", 2);
+
+	ar_write(w, digits + sizeof(digits) - n, n);
+}
+
+// the process mappings pprof symbolizes addresses with
+void ar_write_maps(struct ArenaWriter *w) {
+	int fd = open("/proc/self/maps", O_RDONLY);
+
+	if (fd < 0) return;
+
+	for (;;) {
+		if (w->len == sizeof(w->buf)) ar_write_flush(w);
+
+		ssize_t n = read(fd, w->buf + w->len, sizeof(w->buf) - w->len);
+
+		if (n < 0 && errno == EINTR) continue;
+		if (n <= 0) break;
+
+		w->len += (size_t)n;
+	}
+
+	close(fd);
+}
+
+int arprof_write(Arena* arena, int fd, ArenaProfileFormat format) {
+	if (!arena || fd < 0) return -1;
+
+#ifndef ARENA_PROFILE
+	(void)format;
+	return -1;
+#else
+	if (format != AR_PROFILE_PPROF && format != AR_PROFILE_FOLDED) return -1;
+
+	struct ArenaProfile *profile = __atomic_load_n(&arena->profile, __ATOMIC_ACQUIRE);
+	struct ArenaWriter w;
+	size_t count = 0;
+	size_t bytes = 0;
+
+	w.fd = fd;
+	w.failed = 0;
+	w.len = 0;
+
+	if (profile) ar_lock(&profile->lock);
+
+	for (size_t i = 0; profile && i < ARENA_PROFILE_SITES; i++) {
+		if (profile->sites[i].gen != profile->gen) continue;
+
+		count += profile->sites[i].count;
+		bytes += profile->sites[i].bytes;
+	}
+
+	if (format == AR_PROFILE_PPROF) {
+		ar_write_str(&w, "heap profile: ");
+		ar_write_num(&w, count, 10);
+		ar_write_str(&w, ": ");
+		ar_write_num(&w, bytes, 10);
+		ar_write_str(&w, " [ ");
+		ar_write_num(&w, count, 10);
+		ar_write_str(&w, ": ");
+		ar_write_num(&w, bytes, 10);
+		ar_write_str(&w, "] @ heapprofile\n");
+	}
+
+	for (size_t i = 0; profile && i < ARENA_PROFILE_SITES; i++) {
+		struct ArenaSite *site = &profile->sites[i];
+
+		if (site->gen != profile->gen) continue;
+
+		if (format == AR_PROFILE_PPROF) {
+			ar_write_num(&w, site->count, 10);
+			ar_write_str(&w, ": ");
+			ar_write_num(&w, site->bytes, 10);
+			ar_write_str(&w, " [ ");
+			ar_write_num(&w, site->count, 10);
+			ar_write_str(&w, ": ");
+			ar_write_num(&w, site->bytes, 10);
+			ar_write_str(&w, "] @");
+
+			for (int f = 0; f < site->depth; f++) {
+				ar_write_str(&w, " ");
+				ar_write_num(&w, (uintptr_t)site->frames[f], 16);
+			}
+		} else {
+			if (site->tag) {
+				ar_write_str(&w, site->tag);
+				if (site->depth) ar_write_str(&w, ";");
+			}
+
+			for (int f = site->depth - 1; f >= 0; f--) {
+				ar_write_num(&w, (uintptr_t)site->frames[f], 16);
+				if (f) ar_write_str(&w, ";");
+			}
+
+			ar_write_str(&w, " ");
+			ar_write_num(&w, site->bytes, 10);
+		}
+
+		ar_write_str(&w, "\n");
+	}
+
+	if (format == AR_PROFILE_FOLDED && profile && profile->dropped) {
+		ar_write_str(&w, "[dropped] ");
+		ar_write_num(&w, profile->dropped, 10);
+		ar_write_str(&w, "\n");
+	}
+
+	if (profile) ar_unlock(&profile->lock);
+
+	if (format == AR_PROFILE_PPROF) {
+		ar_write_str(&w, "\nMAPPED_LIBRARIES:\n");
+		ar_write_maps(&w);
+	}
+
+	ar_write_flush(&w);
+	return w.failed ? -1 : 0;
+#endif
+}
+
+// ALLOCATION PROFILING
+
+
+// ==========================================
+// 		ARENA HANDLING
+// ==========================================
+
+// ------------------------------------------
+// ARENA_DEBUG: an allocation is laid out as
+//	[struct ArenaDebug][size bytes][ARENA_REDZONE canary bytes]
+// the header right before the data, which keeps its alignment. Headers
+// are linked newest first, so a reset or rewind checks exactly what it
+// releases.
+// ------------------------------------------
+
+struct ArenaDebug {
+	struct ArenaDebug *prev;
+	size_t size;
+	uint64_t canary;
+};
+
+#define AR_CANARY 0xa5e2a3c0ffee5a1dull
+#define AR_CANARY_BYTE 0xcb
+#define AR_DEBUG_HDR AR_ALIGN_UP(sizeof(struct ArenaDebug))
+
+// calls ARENA_DEBUG_FAIL for each damaged allocation from the newest
+// down to <stop>, returns how many there were
+AR_NO_ASAN size_t ar_debug_scan(Arena* arena, struct ArenaDebug *stop) {
+	size_t damaged = 0;
+
+	for (struct ArenaDebug *hdr = arena->debug; hdr && hdr != stop; hdr = hdr->prev) {
+		const unsigned char *tail = (const unsigned char *)(hdr + 1) + hdr->size;
+		int intact = hdr->canary == (AR_CANARY ^ (uintptr_t)hdr);
+
+		for (size_t i = 0; intact && i < ARENA_REDZONE; i++)
+			intact = tail[i] == AR_CANARY_BYTE;
+
+		if (!intact) {
+			ARENA_DEBUG_FAIL(arena, (void *)(hdr + 1));
+			damaged++;
+		}
+	}
+
+	return damaged;
+}
+
+// checks the allocations down to <stop> and forgets them
+void ar_debug_check(Arena* arena, struct ArenaDebug *stop) {
+#ifdef ARENA_DEBUG
+	ar_debug_scan(arena, stop);
+	arena->debug = stop;
+#else
+	(void)arena;
+	(void)stop;
+#endif
+}
+
+void *ar_alloc(Arena* arena, size_t size, size_t align);
+
+void *ar_debug_alloc(Arena* arena, size_t size, size_t align) {
+	if (align < AR_ALIGN) align = AR_ALIGN;
+
+	// the data keeps <align>, the header fits in front of it
+	size_t head = align > AR_DEBUG_HDR ? align : AR_DEBUG_HDR;
+
+	if (size > (size_t)-1 - head - ARENA_REDZONE) return NULL;
+
+	size_t bytes = head + size + ARENA_REDZONE;
+	char *raw = ar_alloc(arena, bytes, align);
+
+	if (!raw) return NULL;
+
+	char *ptr = raw + head;
+	struct ArenaDebug *hdr = (struct ArenaDebug *)ptr - 1;
+
+	AR_UNPOISON(raw, bytes);
+
+	hdr->size = size;
+	hdr->canary = AR_CANARY ^ (uintptr_t)hdr;
+	memset(ptr + size, AR_CANARY_BYTE, ARENA_REDZONE);
+
+	// AR_SHARED threads push concurrently
+	hdr->prev = __atomic_load_n(&arena->debug, __ATOMIC_RELAXED);
+	while (!__atomic_compare_exchange_n(&arena->debug, &hdr->prev, hdr, 1,
+					    __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+
+	AR_STAT(__atomic_fetch_sub(&arena->requested, head + ARENA_REDZONE,
+				   __ATOMIC_RELAXED));
+
+	AR_POISON(raw, bytes);
+	AR_UNPOISON(ptr, size);
+	return ptr;
+}
+
+int archeck(Arena* arena) {
+	if (!arena) return -1;
+
+#ifdef ARENA_DEBUG
+	if (ar_debug_scan(arena, NULL)) return -1;
+#endif
+
+	return 0;
+}
+
+struct Arena *arinit (ArenaType type) {
+	ArenaConfig config = { 0 };
+
+	config.type = type;
+	return arinit_ex(&config);
+}
+
+// moves the Arena into <head>, right after the chunk header
+struct Arena *arena_place(struct Chunk *head, const ArenaConfig *config) {
+	struct Arena *new_arena = (struct Arena *)head->memory;
+
+	head->memory += AR_ARENA_HDR;
+	head->capacity -= AR_ARENA_HDR;
+	head->reserved -= AR_ARENA_HDR;
+	head->dirty = head->dirty > AR_ARENA_HDR ? head->dirty - AR_ARENA_HDR : 0;
+
+	// cached chunks come back with old contents
+	memset(new_arena, 0, sizeof(*new_arena));
+
+	new_arena->type = config->type;
+	new_arena->head = head;
+	new_arena->curr = head;
+	new_arena->idle_next = NULL;
+	new_arena->lock = 0;
+	new_arena->growth_factor = config->growth_factor ? config->growth_factor : 2;
+	new_arena->growth_step = config->growth_step;
+	new_arena->max_size = config->max_size;
+	new_arena->large_size = config->large_size;
+	new_arena->refill_percent = config->refill_percent ? config->refill_percent : 75;
+	new_arena->flags = config->flags;
+	new_arena->numa_node = -1;
+	new_arena->total = head->capacity;
+
+	return new_arena;
+}
+
+void arena_refill_arm(Arena* arena);
+
+struct Arena *arinit_ex (const ArenaConfig *config) {
+	if (!config) return NULL;
+
+	ArenaType type = config->type;
+
+	if (type < AR_FIXED || type > AR_SHARED) return NULL;
+
+	if (config->refill_percent > 100) return NULL;
+
+	// only arinit_file maps memory that must not be written
+	if (config->flags & AR_READONLY) return NULL;
+
+	int node = -1;
+
+	if (config->flags & AR_NUMA_BIND) {
+		node = config->numa_node;
+
+		if (node < 0 || node >= AR_NUMA_NODES) return NULL;
+	} else if (config->flags & AR_NUMA_LOCAL) {
+		node = ar_numa_node();
+	}
+
+	unsigned map_flags = chunk_numa_flags(config->flags, node);
+	size_t headers = AR_CHUNK_HDR + AR_ARENA_HDR;
+	size_t init_size = config->initial_size;
+	size_t max_size = config->max_size;
+	struct Chunk *head;
+
+	if (init_size > (size_t)-1 - headers - AR_PAGE_SIZE) return NULL;
+
+	if (!init_size && (type == AR_FIXED || type == AR_VIRTUAL)) init_size = AR_PAGE_SIZE * 16;
+
+	// mapping size, initial_size is usable on top of the headers. Growing
+	// arenas start at one page, headers included.
+	size_t span = init_size ? AR_PAGE_UP(init_size + headers) : AR_PAGE_SIZE;
+
+	if (type == AR_VIRTUAL) {
+		if (max_size > (size_t)-1 - AR_PAGE_SIZE) return NULL;
+
+		// the headers come out of the reservation
+		size_t reserve = max_size ? AR_PAGE_UP(max_size) : AR_VIRTUAL_RESERVE;
+
+		if (span > reserve) span = reserve;
+
+		head = chunk_reserve(reserve, span - AR_CHUNK_HDR, map_flags);
+	} else {
+		if (max_size && init_size > max_size) return NULL;
+
+		// huge page multiples, chunk_init skips the cache for them
+		if ((config->flags & AR_HUGEPAGES) && span >= AR_HUGE_PAGE &&
+		    span <= (size_t)-1 - AR_HUGE_PAGE &&
+		    (!max_size || AR_HUGE_UP(span) - headers <= max_size))
+			span = AR_HUGE_UP(span);
+
+		head = chunk_init(type, span, map_flags);
+
+		if (max_size) head = chunk_map_exact(head, span, map_flags,
+						     span - AR_CHUNK_HDR);
+
+		// the limit is on usable bytes, the mapping stays whole pages
+		if (head && max_size && head->capacity - AR_ARENA_HDR > max_size)
+			head->capacity = AR_ARENA_HDR + (max_size & ~(size_t)(AR_ALIGN - 1));
+	}
+
+	if (!head) return NULL;
+
+	// an explicit node has to work, a local one is a hint
+	if (chunk_bind_prefault(head, config->flags, node) != 0) {
+		if (config->flags & AR_NUMA_BIND) {
+			if (type == AR_VIRTUAL) chunk_destroy(head);
+			else chunk_release(head);
+			return NULL;
+		}
+
+		node = -1;
+	}
+
+	Arena *arena = arena_place(head, config);
+
+	arena->numa_node = node;
+	AR_POISON(head->memory, head->capacity);
+	arena_refill_arm(arena);
+	return arena;
+}
+
+// size to grow to from <prev> bytes, at least <need>, 0 on overflow
+size_t arena_grow_size(Arena* arena, size_t prev, size_t need) {
+	size_t next_size;
+
+	if (arena->growth_step)
+		next_size = (prev > (size_t)-1 - arena->growth_step) ?
+			    need : prev + arena->growth_step;
+	else
+		next_size = (prev > (size_t)-1 / arena->growth_factor) ?
+			    need : prev * arena->growth_factor;
+
+	if (next_size < need) next_size = need;
+
+	if (next_size > (size_t)-1 - AR_PAGE_SIZE) return 0;
+
+	return AR_PAGE_UP(next_size);
+}
+
+// mapping size of the chunk chunk_next links for <need> bytes, header
+// included, 0 if growth would fail
+size_t arena_next_span(Arena* arena, size_t need) {
+	if (need > (size_t)-1 - AR_CHUNK_HDR - AR_PAGE_SIZE) return 0;
+
+	// mapping sizes, the header comes out of the new chunk
+	size_t next_size = arena_grow_size(arena, chunk_span(arena->curr),
+					   need + AR_CHUNK_HDR);
+
+	if (!next_size) return 0;
+
+	if ((arena->flags & AR_HUGEPAGES) && next_size >= AR_HUGE_PAGE &&
+	    next_size <= (size_t)-1 - AR_HUGE_PAGE)
+		next_size = AR_HUGE_UP(next_size);
+
+	if (arena->max_size) {
+		size_t left = (arena->max_size > arena->total) ?
+			      (arena->max_size - arena->total) & ~(size_t)(AR_ALIGN - 1) : 0;
+
+		if (need > left) return 0;
+		if (next_size - AR_CHUNK_HDR > left) next_size = left + AR_CHUNK_HDR;
+	}
+
+	return next_size;
+}
+
+// ------------------------------------------
+// Large allocations: one chunk each, on arena->large rather than after
+// curr. Only AR_DYNAMIC and AR_SHARED chains grow, so only they have
+// large allocations.
+// ------------------------------------------
+
+// whether <need> bytes that don't fit <curr> get a chunk of their own,
+// AR_SHARED callers hold the lock
+int arena_is_large(Arena* arena, struct Chunk *curr, size_t need) {
+	if (arena->type != AR_DYNAMIC && arena->type != AR_SHARED) return 0;
+
+	if (arena->large_size == (size_t)-1 || need < arena->large_size) return 0;
+
+	// chunk_next reuses a retained chunk that fits
+	for (struct Chunk *chunk = curr->next; chunk; chunk = chunk->next)
+		if (need <= chunk->capacity) return 0;
+
+	if (arena->large_size) return 1;
+
+	// chunk_next would map a chunk sized after it
+	size_t next_size = arena_grow_size(arena, chunk_span(curr), 0);
+
+	return !next_size || need > next_size - AR_CHUNK_HDR;
+}
+
+void *ar_large_alloc(Arena* arena, size_t size, size_t align) {
+	if (size > (size_t)-1 - align - AR_CHUNK_HDR - AR_PAGE_SIZE) return NULL;
+
+	// chunk memory is only cache line aligned
+	size_t fit = AR_PAGE_UP(size + align - 1 + AR_CHUNK_HDR);
+	size_t span = fit;
+
+	if ((arena->flags & AR_HUGEPAGES) && span >= AR_HUGE_PAGE &&
+	    span <= (size_t)-1 - AR_HUGE_PAGE)
+		span = AR_HUGE_UP(span);
+
+	unsigned flags = chunk_numa_flags(arena->flags, arena->numa_node);
+	struct Chunk *chunk = chunk_init(AR_DYNAMIC, span, flags);
+
+	if (!chunk) return NULL;
+
+	ar_lock(&arena->lock);
+
+	size_t left = (size_t)-1;
+
+	if (arena->max_size)
+		left = arena->max_size > arena->total ? arena->max_size - arena->total : 0;
+
+	// huge page rounding may be larger than the limit too
+	if (fit - AR_CHUNK_HDR <= left) chunk = chunk_map_exact(chunk, fit, flags, left);
+
+	if (!chunk || chunk->capacity > left) {
+		ar_unlock(&arena->lock);
+		if (chunk) chunk_release(chunk);
+		return NULL;
+	}
+
+	chunk_bind_prefault(chunk, arena->flags, arena->numa_node);
+
+	AR_POISON(chunk->memory, chunk->capacity);
+
+	chunk->next = arena->large;
+	arena->large = chunk;
+	arena->total += chunk->capacity;
+	AR_STAT(arena->expansions++);
+	ARENA_TRACE(AR_EVENT_GROW, arena, chunk);
+
+	ar_unlock(&arena->lock);
+
+	AR_STAT(__atomic_fetch_add(&arena->requested, size, __ATOMIC_RELAXED));
+	return chunk_bump(chunk, size, align);
+}
+
+// hands the large allocations made after <keep> back to the cache
+void arena_release_large(Arena* arena, struct Chunk *keep) {
+	while (arena->large && arena->large != keep) {
+		struct Chunk *chunk = arena->large;
+
+		arena->large = chunk->next;
+		arena->total -= chunk->capacity;
+		chunk_release(chunk);
+	}
+}
+
+// ------------------------------------------
+// AR_REFILL: curr's capacity is cut to the threshold, so aralloc and
+// aralloc_fast stay as they are and the crossing takes aralloc_slow.
+// That restores it and queues the arena for the helper thread, which
+// leaves the chunk it maps in arena->spare.
+// ------------------------------------------
+
+static pthread_mutex_t ar_refill_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t ar_refill_work = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t ar_refill_done = PTHREAD_COND_INITIALIZER;
+static pthread_once_t ar_refill_once = PTHREAD_ONCE_INIT;
+static Arena *ar_refill_queue;
+static Arena *ar_refill_busy; // arena the helper is mapping for
+static int ar_refill_running;
+
+void *ar_refill_main(void *unused) {
+	(void)unused;
+
+	pthread_mutex_lock(&ar_refill_mutex);
+
+	for (;;) {
+		while (!ar_refill_queue) pthread_cond_wait(&ar_refill_work, &ar_refill_mutex);
+
+		Arena *arena = ar_refill_queue;
+		size_t span = arena->refill_span;
+
+		ar_refill_queue = arena->refill_next;
+		ar_refill_busy = arena;
+		pthread_mutex_unlock(&ar_refill_mutex);
+
+		// prefaulted here with AR_PREFAULT
+		struct Chunk *chunk = chunk_init(AR_DYNAMIC, span,
+						 chunk_numa_flags(arena->flags, arena->numa_node));
+
+		if (chunk) chunk_bind_prefault(chunk, arena->flags, arena->numa_node);
+
+		struct Chunk *none = NULL;
+
+		if (chunk && !__atomic_compare_exchange_n(&arena->spare, &none, chunk, 0,
+							   __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+			chunk_release(chunk);
+
+		pthread_mutex_lock(&ar_refill_mutex);
+		arena->refill_pending = 0;
+		ar_refill_busy = NULL;
+		pthread_cond_broadcast(&ar_refill_done);
+	}
+
+	return NULL;
+}
+
+void ar_refill_start(void) {
+	pthread_attr_t attr;
+	pthread_t thread;
+
+	if (pthread_attr_init(&attr) != 0) return;
+
+	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+
+	if (pthread_create(&thread, &attr, ar_refill_main, NULL) == 0)
+		__atomic_store_n(&ar_refill_running, 1, __ATOMIC_RELEASE);
+
+	pthread_attr_destroy(&attr);
+}
+
+// asks the helper for the chunk after curr, growth maps it itself if the
+// helper can't be started
+void arena_refill_request(Arena* arena) {
+	size_t span = arena_next_span(arena, 0);
+
+	if (span <= AR_CHUNK_HDR) return;
+
+	pthread_once(&ar_refill_once, ar_refill_start);
+
+	if (!__atomic_load_n(&ar_refill_running, __ATOMIC_ACQUIRE)) return;
+
+	pthread_mutex_lock(&ar_refill_mutex);
+
+	if (!arena->refill_pending) {
+		arena->refill_pending = 1;
+		arena->refill_span = span;
+		arena->refill_next = ar_refill_queue;
+		ar_refill_queue = arena;
+		pthread_cond_signal(&ar_refill_work);
+	}
+
+	pthread_mutex_unlock(&ar_refill_mutex);
+}
+
+// cuts curr's capacity to the threshold once it is the last chunk,
+// retained chunks are reused first, see chunk_next
+void arena_refill_arm(Arena* arena) {
+	struct Chunk *curr = arena->curr;
+
+	if (!(arena->flags & AR_REFILL) || arena->type != AR_DYNAMIC) return;
+
+	if (curr->next || __atomic_load_n(&arena->spare, __ATOMIC_ACQUIRE)) return;
+
+	size_t limit = (curr->capacity / 100 * arena->refill_percent) & ~(size_t)(AR_ALIGN - 1);
+
+	if (limit <= curr->offset) {
+		arena_refill_request(arena);
+		return;
+	}
+
+	arena->refill_chunk = curr;
+	arena->refill_capacity = curr->capacity;
+	curr->capacity = limit;
+}
+
+void arena_refill_disarm(Arena* arena) {
+	if (!arena->refill_chunk) return;
+
+	arena->refill_chunk->capacity = arena->refill_capacity;
+	arena->refill_chunk = NULL;
+}
+
+// curr crossed the threshold
+void arena_refill_fire(Arena* arena) {
+	arena_refill_disarm(arena);
+	arena_refill_request(arena);
+}
+
+// takes the helper's chunk if it maps at least <span> bytes
+struct Chunk *arena_refill_take(Arena* arena, size_t span) {
+	if (!(arena->flags & AR_REFILL)) return NULL;
+
+	struct Chunk *spare = __atomic_exchange_n(&arena->spare, NULL, __ATOMIC_ACQUIRE);
+
+	if (spare && chunk_span(spare) < span) {
+		chunk_release(spare);
+		return NULL;
+	}
+
+	return spare;
+}
+
+// waits out the helper and drops its chunk
+void arena_refill_cancel(Arena* arena) {
+	if (!(arena->flags & AR_REFILL)) return;
+
+	arena_refill_disarm(arena);
+
+	pthread_mutex_lock(&ar_refill_mutex);
+
+	for (Arena **link = &ar_refill_queue; *link; link = &(*link)->refill_next) {
+		if (*link == arena) {
+			*link = arena->refill_next;
+			break;
+		}
+	}
+
+	while (ar_refill_busy == arena) pthread_cond_wait(&ar_refill_done, &ar_refill_mutex);
+
+	arena->refill_pending = 0;
+	pthread_mutex_unlock(&ar_refill_mutex);
+
+	struct Chunk *spare = __atomic_exchange_n(&arena->spare, NULL, __ATOMIC_ACQUIRE);
+
+	if (spare) chunk_release(spare);
+}
+
+void arfree(Arena* arena) {
+	if (!arena) return;
+
+	ar_debug_check(arena, NULL);
+	ar_profile_free(arena);
+	arena_release_large(arena, NULL);
+	arena_refill_cancel(arena);
+
+	ArenaType type = arena->type;
+	struct Chunk *head = arena->head;
+	struct Chunk *cursor = head->next;
+
+	// the arena lives in the head chunk, it goes last
+	while (cursor) {
+		struct Chunk *next = cursor->next;
+
+		chunk_release(cursor);
+		cursor = next;
+	}
+
+	// reservations and files are never cached
+	if (type == AR_VIRTUAL || (head->flags & AR_CHUNK_FILE)) chunk_destroy(head);
+	else chunk_release(head);
+}
+
+// Returns the chunk to continue in once curr is full, with at least
+// <need> bytes, linked right after curr. Does not move curr.
+struct Chunk *chunk_next(Arena* arena, size_t need) {
+	struct Chunk *next = arena->curr->next;
+
+	// chunks after curr are retained by arreset/arrewind, reuse the first
+	// that fits and move it up so the smaller ones stay for later
+	for (struct Chunk *prev = arena->curr; prev->next; prev = prev->next) {
+		struct Chunk *fit = prev->next;
+
+		if (need > fit->capacity) continue;
+
+		if (fit != next) {
+			prev->next = fit->next;
+			fit->next = next;
+			arena->curr->next = fit;
+		}
+
+		chunk_rewind(fit, 0);
+		return fit;
+	}
+
+	size_t next_size = arena_next_span(arena, need);
+	size_t left = (size_t)-1;
+
+	if (!next_size) return NULL;
+
+	if (arena->max_size)
+		left = (arena->max_size > arena->total) ?
+		       (arena->max_size - arena->total) & ~(size_t)(AR_ALIGN - 1) : 0;
+
+	// AR_REFILL mapped and bound it already
+	struct Chunk* new_chunk = arena_refill_take(arena, next_size);
+	int bound = new_chunk != NULL;
+
+	unsigned flags = chunk_numa_flags(arena->flags, arena->numa_node);
+
+	if (!new_chunk) new_chunk = chunk_init(AR_DYNAMIC, next_size, flags);
+
+	if(!new_chunk) return NULL;
+
+	if (new_chunk->capacity > left) {
+		new_chunk = chunk_map_exact(new_chunk, next_size, flags, left);
+		bound = 0;
+
+		if(!new_chunk) return NULL;
+	}
+
+	if (!bound) chunk_bind_prefault(new_chunk, arena->flags, arena->numa_node);
+
+	AR_POISON(new_chunk->memory, new_chunk->capacity);
+	new_chunk->next = next;
+	arena->curr->next = new_chunk;
+	arena->total += new_chunk->capacity;
+	AR_STAT(arena->expansions++);
+	ARENA_TRACE(AR_EVENT_GROW, arena, new_chunk);
+
+	return new_chunk;
+}
+
+// ------------------------------------------
+// AR_SHARED: offsets are bumped atomically and stay multiples of
+// AR_ALIGN. A thread that overshoots the chunk takes the growth lock,
+// the first one in links the next chunk and publishes it as curr.
+// ------------------------------------------
+
+// makes sure curr is past the exhausted <chunk>
+int ar_shared_grow(Arena* arena, struct Chunk *chunk, size_t need) {
+	int ret = 0;
+
+	ar_lock(&arena->lock);
+
+	// another thread already moved on
+	if (__atomic_load_n(&arena->curr, __ATOMIC_RELAXED) == chunk) {
+		struct Chunk *next = chunk_next(arena, need);
+
+		if (next) __atomic_store_n(&arena->curr, next, __ATOMIC_RELEASE);
+		else ret = -1;
+	}
+
+	ar_unlock(&arena->lock);
+	return ret;
+}
+
+void *ar_shared_alloc(Arena* arena, size_t size, size_t align) {
+	if (size > (size_t)-1 - align - AR_ALIGN) return NULL;
+
+	size_t bytes = AR_ALIGN_UP(size);
+	struct Chunk *curr = __atomic_load_n(&arena->curr, __ATOMIC_ACQUIRE);
+
+	size_t used = __atomic_load_n(&curr->offset, __ATOMIC_RELAXED);
+
+	// only a hint, the bump below decides
+	if (used > curr->capacity || bytes + align > curr->capacity - used) {
+		ar_lock(&arena->lock);
+		int large = arena_is_large(arena, curr, bytes + align - 1);
+		ar_unlock(&arena->lock);
+
+		if (large) return ar_large_alloc(arena, size, align);
+	}
+
+	for (;;) {
+		struct Chunk *chunk = __atomic_load_n(&arena->curr, __ATOMIC_ACQUIRE);
+		size_t offset;
+
+		if (align <= AR_ALIGN) {
+			offset = __atomic_fetch_add(&chunk->offset, bytes, __ATOMIC_RELAXED);
+
+			if (offset <= chunk->capacity && bytes <= chunk->capacity - offset) {
+				AR_STAT(__atomic_fetch_add(&arena->requested, size,
+							   __ATOMIC_RELAXED));
+				return chunk->memory + offset;
+			}
+		} else {
+			offset = __atomic_load_n(&chunk->offset, __ATOMIC_RELAXED);
+
+			while (offset <= chunk->capacity) {
+				uintptr_t addr = (uintptr_t)(chunk->memory + offset);
+				size_t pad = (size_t)(-addr & (align - 1));
+
+				if (pad > chunk->capacity - offset ||
+				    bytes > chunk->capacity - offset - pad) break;
+
+				if (__atomic_compare_exchange_n(&chunk->offset, &offset,
+								offset + pad + bytes, 1,
+								__ATOMIC_RELAXED,
+								__ATOMIC_RELAXED)) {
+					AR_STAT(__atomic_fetch_add(&arena->requested, size,
+								   __ATOMIC_RELAXED));
+					return (void *)(addr + pad);
+				}
+			}
+		}
+
+		if (ar_shared_grow(arena, chunk, bytes + align - 1) != 0) return NULL;
+	}
+}
+
+void *aralloc(Arena* arena, size_t size) {
+	return aralloc_aligned(arena, size, AR_ALIGN);
+}
+
+void *aralloc_aligned(Arena* arena, size_t size, size_t align) {
+	if (!arena) return NULL;
+
+	// align must be a power of two
+	if (align == 0 || (align & (align - 1)) != 0) return NULL;
+
+#ifdef ARENA_DEBUG
+	void *ptr = ar_debug_alloc(arena, size, align);
+#else
+	void *ptr = ar_alloc(arena, size, align);
+#endif
+
+	return ptr ? AR_SAMPLE(arena, size, ptr) : NULL;
+}
+
+// allocation without the ARENA_DEBUG layout
+void *ar_alloc(Arena* arena, size_t size, size_t align) {
+	if (arena->flags & AR_READONLY) return NULL;
+
+	if (arena->type == AR_SHARED) return ar_shared_alloc(arena, size, align);
+
+	void *ptr = chunk_bump(arena->curr, size, align);
+
+	if (ptr) {
+		AR_STAT(arena->requested += size);
+		return ptr;
+	}
+
+	return aralloc_slow(arena, size, align);
+}
+
+// Only the part of the allocation below the chunk's dirty mark can
+// hold old data, fresh mmap pages past it are known to be zero.
+void *arcalloc(Arena* arena, size_t count, size_t size) {
+	if (count && size > (size_t)-1 / count) return NULL;
+
+	size_t bytes = count * size;
+	char *ptr = aralloc(arena, bytes);
+
+	if (!ptr) return NULL;
+
+	// curr may have moved on under AR_SHARED
+	if (arena->type == AR_SHARED) return memset(ptr, 0, bytes);
+
+	struct Chunk *chunk = arena->curr;
+	struct Chunk *large = arena->large;
+
+	// large allocations have a chunk of their own
+	if (large && ptr >= large->memory && ptr < large->memory + large->capacity)
+		chunk = large;
+
+	size_t start = (size_t)(ptr - chunk->memory);
+
+	if (start < chunk->dirty)
+		memset(ptr, 0, bytes < chunk->dirty - start ? bytes : chunk->dirty - start);
+
+	return ptr;
+}
+
+// one bump for <count> objects, laid out as aralloc would place them
+void *aralloc_batch(Arena* arena, size_t size, size_t count, void **out) {
+	if (!arena || count == 0) return NULL;
+	if (size > (size_t)-1 - AR_ALIGN) return NULL;
+
+	size_t stride = AR_ALIGN_UP(size);
+
+	if (stride && count - 1 > ((size_t)-1 - size) / stride) return NULL;
+
+	char *base = aralloc(arena, stride * (count - 1) + size);
+
+	if (!base || !out) return base;
+
+	for (size_t i = 0; i < count; i++) out[i] = base + i * stride;
+
+	return base;
+}
+
+// growth path, called once the current chunk can't fit <size>
+void *aralloc_slow(Arena* arena, size_t size, size_t align) {
+	// Not enough space in chunk
+	if (arena->type == AR_FIXED) return NULL;
+
+	// commit more of the reservation, memory stays contiguous
+	if (arena->type == AR_VIRTUAL) {
+		struct Chunk *chunk = arena->curr;
+		uintptr_t addr = (uintptr_t)(chunk->memory + chunk->offset);
+		size_t pad = (size_t)(-addr & (align - 1));
+		size_t left = chunk->reserved - chunk->offset;
+
+		if (pad > left || size > left - pad) return NULL;
+
+		size_t commit = arena_grow_size(arena, chunk->capacity,
+						chunk->offset + pad + size);
+
+		if (chunk_commit(chunk, commit, arena->flags) != 0) return NULL;
+
+		AR_STAT(arena->expansions++);
+		AR_STAT(arena->requested += size);
+		return chunk_bump(chunk, size, align);
+	}
+
+	if (arena->type == AR_SHARED) return ar_shared_alloc(arena, size, align);
+
+	if (arena->type == AR_DYNAMIC) {
+		// worst case padding, a fresh chunk is page aligned
+		if (size > (size_t)-1 - align) return NULL;
+
+		// the AR_REFILL threshold, not the end of curr
+		if (arena->refill_chunk) {
+			arena_refill_fire(arena);
+
+			void *ptr = chunk_bump(arena->curr, size, align);
+
+			if (ptr) {
+				AR_STAT(arena->requested += size);
+				return ptr;
+			}
+		}
+
+		if (arena_is_large(arena, arena->curr, size + align - 1))
+			return ar_large_alloc(arena, size, align);
+
+		struct Chunk *next = chunk_next(arena, size + align - 1);
+
+		if (!next) return NULL;
+
+		arena->curr = next;
+		arena_refill_arm(arena);
+		AR_STAT(arena->requested += size);
+
+		return chunk_bump(arena->curr, size, align);
+	}
+
+	return NULL;
+}
+
+void arreset(Arena* arena) {
+	ArenaResetPolicy policy = { AR_RESET_KEEP, 0 };
+
+	arreset_ex(arena, policy);
+}
+
+// gives back the whole pages in [from, to) with <advice>, returns where
+// the released range starts, <to> if nothing was released
+char *ar_release_pages(char *from, char *to, int advice) {
+	char *begin = (char *)AR_PAGE_UP((uintptr_t)from);
+	char *end = (char *)((uintptr_t)to & ~((uintptr_t)AR_PAGE_SIZE - 1));
+
+	if (begin >= end || madvise(begin, (size_t)(end - begin), advice) != 0) return to;
+
+	return begin;
+}
+
+// bytes in use, from head up to curr
+size_t arena_usage(Arena* arena) {
+	size_t used = 0;
+
+	for (struct Chunk *chunk = arena->head; chunk; chunk = chunk->next) {
+		used += chunk->offset < chunk->capacity ? chunk->offset : chunk->capacity;
+
+		if (chunk == arena->curr) break;
+	}
+
+	return used;
+}
+
+// what AR_RESET_ADAPTIVE keeps for the usage: chunk chains need whole
+// chunks, head up to curr, reservations and fixed chunks the bytes used
+size_t arena_footprint(Arena* arena) {
+	if (arena->type != AR_DYNAMIC && arena->type != AR_SHARED) return arena_usage(arena);
+
+	size_t bytes = 0;
+
+	for (struct Chunk *chunk = arena->head; chunk; chunk = chunk->next) {
+		bytes += chunk->capacity;
+
+		if (chunk == arena->curr) break;
+	}
+
+	return bytes;
+}
+
+#ifdef ARENA_STATS
+void arstat_peak(Arena* arena, size_t used) {
+	if (used > arena->peak) arena->peak = used;
+}
+#endif
+
+// high percentile of the usage seen by the last AR_USAGE_WINDOW resets
+size_t arena_usage_percentile(Arena* arena) {
+	size_t sorted[AR_USAGE_WINDOW];
+	unsigned n = arena->usage_count;
+
+	memcpy(sorted, arena->usage, sizeof(sorted));
+
+	for (unsigned i = 1; i < n; i++) {
+		size_t v = sorted[i];
+		unsigned j = i;
+
+		for (; j > 0 && sorted[j - 1] > v; j--) sorted[j] = sorted[j - 1];
+		sorted[j] = v;
+	}
+
+	return n ? sorted[(n * 9) / 10 < n ? (n * 9) / 10 : n - 1] : 0;
+}
+
+// drops chunks past the first <keep> bytes, shrinks the rest to <keep>
+void arena_trim(Arena* arena, size_t keep) {
+	struct Chunk *chunk = arena->head;
+
+	// file pages hold the data, not scratch
+	if (chunk->flags & AR_CHUNK_FILE) return;
+
+	if (arena->type == AR_VIRTUAL) {
+		size_t head = (size_t)(chunk->memory - (char *)chunk);
+
+		if (keep > chunk->capacity) return;
+
+		// memory + capacity stays on a page boundary, see chunk_commit
+		size_t commit = AR_PAGE_UP(head + keep) - head;
+
+		if (commit >= chunk->capacity) return;
+
+		char *begin = chunk->memory + commit;
+		size_t len = chunk->capacity - commit;
+
+		AR_UNPOISON(begin, len);
+		madvise(begin, len, MADV_DONTNEED);
+		mprotect(begin, len, PROT_NONE);
+
+		chunk->capacity = commit;
+		if (chunk->dirty > commit) chunk->dirty = commit;
+		return;
+	}
+
+	if (arena->type == AR_FIXED) {
+		char *end = chunk->memory + chunk->capacity;
+		char *begin = ar_release_pages(chunk->memory + keep, end, MADV_DONTNEED);
+		size_t clean = (size_t)(begin - chunk->memory);
+
+		// a partial last page is left alone with what it holds
+		size_t tail = (size_t)(((uintptr_t)end & ~((uintptr_t)AR_PAGE_SIZE - 1)) -
+				       (uintptr_t)chunk->memory);
+
+		if (chunk->dirty > clean && chunk->dirty <= tail) chunk->dirty = clean;
+		return;
+	}
+
+	// the head chunk always stays
+	size_t kept = chunk->capacity;
+
+	while (chunk->next && kept + chunk->next->capacity <= keep) {
+		chunk = chunk->next;
+		kept += chunk->capacity;
+	}
+
+	struct Chunk *drop = chunk->next;
+	chunk->next = NULL;
+
+	while (drop) {
+		struct Chunk *next = drop->next;
+
+		arena->total -= drop->capacity;
+		chunk_release(drop);
+		drop = next;
+	}
+	// sized for the growth just trimmed
+	struct Chunk *spare = arena_refill_take(arena, 0);
+
+	if (spare) chunk_release(spare);
+}
+
+// replaces the chunks after the head, which holds the arena, by one
+// chunk as large as all of them
+void arena_coalesce(Arena* arena) {
+	if (arena->type != AR_DYNAMIC && arena->type != AR_SHARED) return;
+
+	struct Chunk *head = arena->head;
+
+	if (!head->next || !head->next->next) return;
+
+	size_t rest = arena->total - head->capacity;
+	unsigned flags = chunk_numa_flags(arena->flags, arena->numa_node);
+	struct Chunk *chunk = chunk_init(arena->type, rest + AR_CHUNK_HDR, flags);
+
+	if (!chunk) return;
+
+	if (arena->max_size) {
+		chunk = chunk_map_exact(chunk, rest + AR_CHUNK_HDR, flags, rest);
+
+		if (!chunk) return;
+	}
+
+	chunk_bind_prefault(chunk, arena->flags, arena->numa_node);
+
+	AR_POISON(chunk->memory, chunk->capacity);
+
+	struct Chunk *old = head->next;
+
+	while (old) {
+		struct Chunk *next = old->next;
+
+		chunk_release(old);
+		old = next;
+	}
+
+	head->next = chunk;
+	arena->curr = head;
+	arena->total = head->capacity + chunk->capacity;
+}
+
+// MADV_FREEs every page past the first <keep> bytes
+void arena_free_tail(Arena* arena, size_t keep) {
+#ifdef MADV_FREE
+	int advice = MADV_FREE;
+#else
+	int advice = MADV_DONTNEED;
+#endif
+
+	if (arena->head->flags & AR_CHUNK_FILE) return;
+
+	for (struct Chunk *chunk = arena->head; chunk; chunk = chunk->next) {
+		size_t skip = keep < chunk->capacity ? keep : chunk->capacity;
+
+		ar_release_pages(chunk->memory + skip, chunk->memory + chunk->capacity,
+				 advice);
+		keep -= skip;
+	}
+}
+
+void arena_file_rewind(Arena* arena, size_t offset);
+
+void arreset_ex(Arena* arena, ArenaResetPolicy policy) {
+	// the mapping is private, but the file's data is all there is
+	if (!arena || (arena->flags & AR_READONLY)) return;
+
+	ar_debug_check(arena, NULL);
+	ar_profile_clear(arena);
+	arena_release_large(arena, NULL);
+	arena_refill_disarm(arena);
+
+	AR_STAT(arstat_peak(arena, arena_usage(arena)));
+	arena->usage[arena->usage_next] = arena_footprint(arena);
+	AR_STAT(arena->requested = 0);
+	AR_STAT(arena->resets++);
+	ARENA_TRACE(AR_EVENT_RESET, arena, arena->head);
+	arena->usage_next = (arena->usage_next + 1) % AR_USAGE_WINDOW;
+	if (arena->usage_count < AR_USAGE_WINDOW) arena->usage_count++;
+
+	struct Chunk *curr = arena->head;
+	while (curr) {
+		chunk_rewind(curr, 0);
+		curr = curr->next;
+	}
+
+	arena->curr = arena->head;
+	arena_file_rewind(arena, 0);
+
+	switch (policy.mode) {
+	case AR_RESET_KEEP:
+		break;
+	case AR_RESET_TRIM:
+		arena_trim(arena, policy.keep);
+		break;
+	case AR_RESET_FREE:
+		arena_free_tail(arena, policy.keep);
+		break;
+	case AR_RESET_ADAPTIVE:
+		arena_trim(arena, arena_usage_percentile(arena));
+		break;
+	case AR_RESET_COALESCE:
+		arena_coalesce(arena);
+		break;
+	}
+
+	arena_refill_arm(arena);
+}
+
+ArenaMark armark(Arena* arena) {
+	ArenaMark mark = { NULL, 0, 0, NULL, NULL };
+
+	if (!arena) return mark;
+
+	mark.chunk = arena->curr;
+	mark.offset = arena->curr->offset;
+	mark.requested = arena->requested;
+	mark.debug = arena->debug;
+	mark.large = arena->large;
+	return mark;
+}
+
+// Chunks after mark.chunk keep stale offsets, aralloc zeroes them
+// when it moves into them again, so rewinding never walks the chain.
+// ARENA_DEBUG does, to release what they hold.
+void arrewind(Arena* arena, ArenaMark mark) {
+	if (!arena || !mark.chunk) return;
+
+	AR_STAT(arstat_peak(arena, arena_usage(arena)));
+	AR_STAT(arena->requested = mark.requested);
+	ar_debug_check(arena, mark.debug);
+	arena_release_large(arena, mark.large);
+	arena_refill_disarm(arena);
+
+#ifdef ARENA_DEBUG
+	for (struct Chunk *chunk = mark.chunk->next; chunk; chunk = chunk->next)
+		chunk_rewind(chunk, 0);
+#endif
+
+	arena->curr = mark.chunk;
+	chunk_rewind(arena->curr, mark.offset);
+	arena_file_rewind(arena, mark.offset);
+	arena_refill_arm(arena);
+}
+
+void *arrealloc(Arena* arena, void *old, size_t old_size, size_t new_size) {
+	// shrinking would let the next allocation overwrite the file
+	if (!arena || (arena->flags & AR_READONLY)) return NULL;
+	if (!old) return aralloc(arena, new_size);
+
+	// ARENA_DEBUG redzones follow every allocation, nothing grows in place
+#ifndef ARENA_DEBUG
+	struct Chunk *chunk = arena->curr;
+	uintptr_t addr = (uintptr_t)old;
+	uintptr_t base = (uintptr_t)chunk->memory;
+
+	// the last allocation of curr resizes in place, other threads may
+	// be bumping an AR_SHARED chunk
+	if (arena->type != AR_SHARED && addr >= base &&
+	    addr - base <= chunk->offset && chunk->offset - (addr - base) == old_size) {
+		size_t start = addr - base;
+
+		// growing across the AR_REFILL threshold stays in place
+		if (chunk == arena->refill_chunk && new_size > chunk->capacity - start)
+			arena_refill_fire(arena);
+
+		if (arena->type == AR_VIRTUAL && new_size > chunk->capacity - start &&
+		    new_size <= chunk->reserved - start) {
+			size_t commit = arena_grow_size(arena, chunk->capacity,
+							start + new_size);
+
+			if (chunk_commit(chunk, commit, arena->flags) == 0)
+				AR_STAT(arena->expansions++);
+		}
+
+		if (new_size <= chunk->capacity - start) {
+			if (new_size < old_size) chunk_rewind(chunk, start + new_size);
+			else chunk->offset = start + new_size;
+
+			AR_STAT(arena->requested += new_size - old_size);
+
+			return old;
+		}
+	}
+#endif
+
+	if (new_size <= old_size) return old;
+
+	void *ptr = aralloc(arena, new_size);
+
+	if (ptr) memcpy(ptr, old, old_size);
+
+	return ptr;
+}
+
+// curr is published the way ar_shared_alloc does, other threads may
+// take the room before the caller does
+int ar_shared_reserve(Arena* arena, size_t size) {
+	if (size > (size_t)-1 - AR_ALIGN) return -1;
+
+	for (;;) {
+		struct Chunk *chunk = __atomic_load_n(&arena->curr, __ATOMIC_ACQUIRE);
+		size_t start = __atomic_load_n(&chunk->offset, __ATOMIC_RELAXED);
+
+		if (start <= chunk->capacity && size <= chunk->capacity - start) {
+			ar_prefault(chunk->memory + start, size);
+			return 0;
+		}
+
+		if (ar_shared_grow(arena, chunk, size + AR_ALIGN - 1) != 0) return -1;
+	}
+}
+
+int arreserve(Arena* arena, size_t size) {
+	if (!arena || (arena->flags & AR_READONLY)) return -1;
+
+	if (arena->type == AR_SHARED) return ar_shared_reserve(arena, size);
+
+	struct Chunk *chunk = arena->curr;
+	size_t start = AR_ALIGN_UP(chunk->offset);
+
+	// what is reserved counts as used, reserving past the AR_REFILL
+	// threshold crosses it
+	if (chunk == arena->refill_chunk &&
+	    (start > chunk->capacity || size > chunk->capacity - start))
+		arena_refill_fire(arena);
+
+	if (start > chunk->capacity || size > chunk->capacity - start) {
+		if (arena->type == AR_FIXED) return -1;
+
+		if (arena->type == AR_VIRTUAL) {
+			if (start > chunk->reserved || size > chunk->reserved - start)
+				return -1;
+
+			size_t commit = arena_grow_size(arena, chunk->capacity,
+							start + size);
+
+			if (chunk_commit(chunk, commit, arena->flags) != 0) return -1;
+
+			AR_STAT(arena->expansions++);
+		} else {
+			if (size > (size_t)-1 - AR_ALIGN) return -1;
+
+			chunk = chunk_next(arena, size + AR_ALIGN - 1);
+
+			if (!chunk) return -1;
+
+			arena->curr = chunk;
+			arena_refill_arm(arena);
+			start = AR_ALIGN_UP(chunk->offset);
+		}
+	}
+
+	ar_prefault(chunk->memory + start, size);
+	return 0;
+}
+
+size_t arhuge_bytes(Arena* arena) {
+	if (!arena) return 0;
+
+	size_t bytes = 0;
+
+	for (struct Chunk *chunk = arena->head; chunk; chunk = chunk->next) {
+		if (chunk->flags & AR_CHUNK_HUGETLB) bytes += chunk->capacity;
+	}
+
+	for (struct Chunk *chunk = arena->large; chunk; chunk = chunk->next) {
+		if (chunk->flags & AR_CHUNK_HUGETLB) bytes += chunk->capacity;
+	}
+
+	return bytes;
+}
+
+int arstats(Arena* arena, ArenaStats *stats) {
+	if (!arena || !stats) return -1;
+
+	memset(stats, 0, sizeof(*stats));
+
+	int past_curr = 0;
+
+	for (struct Chunk *chunk = arena->head; chunk; chunk = chunk->next) {
+		size_t used = chunk->offset < chunk->capacity ? chunk->offset : chunk->capacity;
+		size_t capacity = chunk == arena->refill_chunk ? arena->refill_capacity : chunk->capacity;
+
+		stats->chunks++;
+		stats->committed += capacity;
+
+		if (past_curr) continue;
+
+		stats->allocated += used;
+
+		if (chunk == arena->curr) past_curr = 1;
+		else stats->wasted += capacity - used;
+	}
+
+	for (struct Chunk *chunk = arena->large; chunk; chunk = chunk->next) {
+		stats->chunks++;
+		stats->committed += chunk->capacity;
+		stats->allocated += chunk->offset;
+	}
+
+	stats->requested = arena->requested;
+	stats->peak = arena->peak > stats->allocated ? arena->peak : stats->allocated;
+	stats->expansions = arena->expansions;
+	stats->resets = arena->resets;
+
+#ifdef ARENA_STATS
+	if (stats->allocated > stats->requested)
+		stats->padding = stats->allocated - stats->requested;
+#else
+	stats->peak = 0;
+#endif
+
+	return 0;
+}
+
+// ARENA HANDLING
+
+
+// ==========================================
+// 		FILE ARENAS
+// ==========================================
+
+// The file starts with the chunk and arena headers, rebuilt on every
+// open, then this one, then the data. The chunk header's offset is live
+// in the file, so what was allocated survives a remap.
+struct ArenaFile {
+	uint64_t magic;
+	uint32_t version;
+	uint32_t headers; // bytes before the data, catches layout changes
+	uint64_t root;    // offset of the root object, 0 for none
+};
+
+#define AR_FILE_MAGIC 0x31454c4946524155ull // "UARFILE1"
+#define AR_FILE_VERSION 1
+#define AR_FILE_HDR AR_LINE_UP(sizeof(struct ArenaFile))
+#define AR_FILE_HEADERS (AR_CHUNK_HDR + AR_ARENA_HDR + AR_FILE_HDR)
+
+struct ArenaFile *arena_file(Arena* arena) {
+	struct Chunk *head = arena->head;
+
+	if (!(head->flags & AR_CHUNK_FILE)) return NULL;
+
+	return (struct ArenaFile *)((char *)head + AR_CHUNK_HDR + AR_ARENA_HDR);
+}
+
+struct Arena *arinit_file(const char *path, size_t capacity, unsigned flags) {
+	if (!path) return NULL;
+	if (capacity > (size_t)-1 - AR_FILE_HEADERS - AR_PAGE_SIZE) return NULL;
+
+	int readonly = (flags & AR_READONLY) != 0;
+	int fd = open(path, readonly ? O_RDONLY : O_RDWR | O_CREAT, 0644);
+
+	if (fd < 0) return NULL;
+
+	struct stat st;
+	size_t span = capacity ? AR_PAGE_UP(capacity + AR_FILE_HEADERS) : 0;
+
+	if (fstat(fd, &st) != 0) {
+		close(fd);
+		return NULL;
+	}
+
+	int fresh = st.st_size == 0;
+
+	// an existing file only ever grows, and never when read-only
+	if (readonly || (size_t)st.st_size > span) span = (size_t)st.st_size;
+
+	if (span < AR_FILE_HEADERS || (fresh && readonly) ||
+	    (!readonly && (size_t)st.st_size < span && ftruncate(fd, (off_t)span) != 0)) {
+		close(fd);
+		return NULL;
+	}
+
+	int populate = 0;
+
+#ifdef MAP_POPULATE
+	if (flags & AR_PREFAULT) populate = MAP_POPULATE;
+#endif
+
+	// read-only maps are private: rebuilding the headers copies one page
+	char *map = mmap(NULL, span, PROT_READ | PROT_WRITE,
+			 (readonly ? MAP_PRIVATE : MAP_SHARED) | populate, fd, 0);
+
+	close(fd);
+
+	if (map == MAP_FAILED) return NULL;
+
+	struct ArenaFile *file = (struct ArenaFile *)(map + AR_CHUNK_HDR + AR_ARENA_HDR);
+	size_t used = ((struct Chunk *)map)->offset;
+
+	if (fresh) {
+		file->magic = AR_FILE_MAGIC;
+		file->version = AR_FILE_VERSION;
+		file->headers = (uint32_t)AR_FILE_HEADERS;
+		file->root = 0;
+		used = 0;
+	} else if (file->magic != AR_FILE_MAGIC || file->version != AR_FILE_VERSION ||
+		   file->headers != AR_FILE_HEADERS ||
+		   used > span - AR_FILE_HEADERS) {
+		munmap(map, span);
+		return NULL;
+	}
+
+	ArenaConfig config = { 0 };
+
+	config.type = AR_FIXED;
+	config.flags = flags & (AR_PREFAULT | AR_READONLY);
+
+	struct Chunk *head = chunk_place(map, span, span - AR_CHUNK_HDR);
+
+	head->flags = AR_CHUNK_FILE;
+
+	Arena *arena = arena_place(head, &config);
+
+	head->memory += AR_FILE_HDR;
+	head->capacity -= AR_FILE_HDR;
+	head->reserved -= AR_FILE_HDR;
+
+	// file contents are never known to be zero. Allocation functions
+	// refuse AR_READONLY, capacities stay AR_ALIGN multiples anyway.
+	head->offset = used;
+	head->dirty = head->capacity;
+	if (readonly) head->capacity = AR_ALIGN_UP(used);
+
+	arena->total = head->capacity;
+
+	ARENA_TRACE(AR_EVENT_MAP, arena, head);
+	return arena;
+}
+
+// forgets the root once what it pointed to is rewound past <offset>
+void arena_file_rewind(Arena* arena, size_t offset) {
+	struct ArenaFile *file = arena_file(arena);
+
+	if (!file || !file->root) return;
+
+	struct Chunk *head = arena->head;
+
+	if (file->root >= (size_t)(head->memory - (char *)head) + offset) file->root = 0;
+}
+
+int arsync(Arena* arena) {
+	if (!arena || !arena_file(arena) || (arena->flags & AR_READONLY)) return -1;
+
+	struct Chunk *head = arena->head;
+	size_t used = head->offset < head->capacity ? head->offset : head->capacity;
+
+	// the headers' page first, then the data, ends rounded up by msync
+	return msync(head, (size_t)(head->memory - (char *)head) + used, MS_SYNC);
+}
+
+// offsets count from the start of the first chunk's mapping, 0 is NULL
+size_t aroffset(Arena* arena, const void *ptr) {
+	if (!arena || !ptr) return 0;
+
+	struct Chunk *head = arena->head;
+	uintptr_t addr = (uintptr_t)ptr;
+	uintptr_t begin = (uintptr_t)head->memory;
+
+	if (addr < begin || addr - begin > head->capacity) return 0;
+
+	return (size_t)(addr - (uintptr_t)head);
+}
+
+void *arptr(Arena* arena, size_t offset) {
+	if (!arena || !offset) return NULL;
+
+	struct Chunk *head = arena->head;
+	size_t begin = (size_t)(head->memory - (char *)head);
+
+	if (offset < begin || offset - begin > head->capacity) return NULL;
+
+	return (char *)head + offset;
+}
+
+int arroot_set(Arena* arena, const void *ptr) {
+	if (!arena || (arena->flags & AR_READONLY)) return -1;
+
+	struct ArenaFile *file = arena_file(arena);
+	size_t offset = aroffset(arena, ptr);
+
+	if (!file || (ptr && !offset)) return -1;
+
+	file->root = offset;
+	return 0;
+}
+
+void *arroot_get(Arena* arena) {
+	if (!arena) return NULL;
+
+	struct ArenaFile *file = arena_file(arena);
+
+	return file ? arptr(arena, (size_t)file->root) : NULL;
+}
+
+// FILE ARENAS
+
+
+// ==========================================
+// 		CONTAINERS
+// ==========================================
+
+// <data> points at the container's element pointer, read and written
+// with memcpy since it may be any T*
+int arvec_grow(Arena* arena, void *data, size_t *cap, size_t need, size_t elem_size) {
+	if (need <= *cap) return 0;
+	if (elem_size == 0) return -1;
+
+	size_t next_cap = *cap ? *cap * 2 : 8;
+
+	if (*cap > (size_t)-1 / 2 || next_cap < need) next_cap = need;
+	if (next_cap > (size_t)-1 / elem_size) return -1;
+
+	void *old;
+	memcpy(&old, data, sizeof(old));
+
+	void *ptr = arrealloc(arena, old, *cap * elem_size, next_cap * elem_size);
+
+	if (!ptr) return -1;
+
+	memcpy(data, &ptr, sizeof(ptr));
+	*cap = next_cap;
+	return 0;
+}
+
+int arstr_append(Arena* arena, ArenaStr *str, const char *src, size_t n) {
+	if (!str || n > (size_t)-1 - str->len - 1) return -1;
+
+	if (arvec_grow(arena, &str->data, &str->cap, str->len + n + 1, 1) != 0)
+		return -1;
+
+	memcpy(str->data + str->len, src, n);
+	str->len += n;
+	str->data[str->len] = '\0';
+	return 0;
+}
+
+int arstr_puts(Arena* arena, ArenaStr *str, const char *src) {
+	return arstr_append(arena, str, src, strlen(src));
+}
+
+int arstr_putc(Arena* arena, ArenaStr *str, char c) {
+	return arstr_append(arena, str, &c, 1);
+}
+
+// CONTAINERS
+
+
+// ==========================================
+// 		OBJECT POOLS
+// ==========================================
+
+// slabs grow from 16 objects up to AR_POOL_SLAB_MAX bytes
+#define AR_POOL_SLAB_MAX (AR_PAGE_SIZE * 16)
+
+// Freed objects form an intrusive list through their first bytes,
+// new ones are carved from the current slab.
+struct ArenaPool {
+	Arena *arena;
+	size_t obj_size; // stride, fits a free list link
+	void *free_list;
+	char *slab;
+	size_t slab_left; // objects left in slab
+	size_t slab_objs; // objects in the next slab
+};
+
+ArenaPool *arpool_init(Arena* arena, size_t obj_size) {
+	if (!arena || obj_size == 0 || obj_size > (size_t)-1 / 32) return NULL;
+
+	ArenaPool *pool = aralloc(arena, sizeof(ArenaPool));
+
+	if (!pool) return NULL;
+
+	if (obj_size < sizeof(void *)) obj_size = sizeof(void *);
+
+	// 16-byte alignment for objects that can use it, 8 for smaller ones
+	size_t align = obj_size >= AR_ALIGN ? AR_ALIGN : sizeof(void *);
+
+	pool->arena = arena;
+	pool->obj_size = (obj_size + align - 1) & ~(align - 1);
+	pool->free_list = NULL;
+	pool->slab = NULL;
+	pool->slab_left = 0;
+	pool->slab_objs = 16;
+
+	return pool;
+}
+
+void *arpool_alloc(ArenaPool *pool) {
+	if (!pool) return NULL;
+
+	if (pool->free_list) {
+		void *obj = pool->free_list;
+		memcpy(&pool->free_list, obj, sizeof(void *));
+		return obj;
+	}
+
+	if (pool->slab_left == 0) {
+		char *slab = aralloc(pool->arena, pool->slab_objs * pool->obj_size);
+
+		if (!slab) return NULL;
+
+		pool->slab = slab;
+		pool->slab_left = pool->slab_objs;
+
+		if (pool->slab_objs * pool->obj_size * 2 <= AR_POOL_SLAB_MAX)
+			pool->slab_objs *= 2;
+	}
+
+	void *obj = pool->slab;
+	pool->slab += pool->obj_size;
+	pool->slab_left--;
+
+	return obj;
+}
+
+void arpool_free(ArenaPool *pool, void *obj) {
+	if (!pool || !obj) return;
+
+	memcpy(obj, &pool->free_list, sizeof(void *));
+	pool->free_list = obj;
+}
+
+// OBJECT POOLS
+
+
+// ==========================================
+// 		ARENA RINGS
+// ==========================================
+
+int arring_init(ArenaRing *ring, ArenaType type, int generations) {
+	if (!ring) return -1;
+
+	memset(ring, 0, sizeof(*ring));
+
+	if (generations < 2 || generations > AR_RING_MAX) return -1;
+
+	for (int i = 0; i < generations; i++) {
+		ring->arenas[i] = arinit(type);
+
+		if (!ring->arenas[i]) {
+			arring_free(ring);
+			return -1;
+		}
+
+		ring->generations = i + 1;
+	}
+
+	ring->current = 0;
+	ring->policy.mode = AR_RESET_KEEP;
+	return 0;
+}
+
+Arena *arring_advance(ArenaRing *ring) {
+	if (!ring || ring->generations == 0) return NULL;
+
+	ring->current = (ring->current + 1) % ring->generations;
+
+	Arena *arena = ring->arenas[ring->current];
+
+	arreset_ex(arena, ring->policy);
+	return arena;
+}
+
+Arena *arring_current(ArenaRing *ring) {
+	return arring_get(ring, 0);
+}
+
+Arena *arring_get(ArenaRing *ring, int age) {
+	if (!ring || age < 0 || age >= ring->generations) return NULL;
+
+	int index = (ring->current - age + ring->generations) % ring->generations;
+
+	return ring->arenas[index];
+}
+
+void arring_free(ArenaRing *ring) {
+	if (!ring) return;
+
+	for (int i = 0; i < ring->generations; i++) arfree(ring->arenas[i]);
+
+	memset(ring, 0, sizeof(*ring));
+}
+
+// ARENA RINGS
+
+
+// ==========================================
+// 		THREAD-LOCAL ARENAS
+// ==========================================
+
+// Released arenas wait in one idle list per type and NUMA node, slot 0
+// holds the unbound ones. Pushes are a CAS loop; a pop detaches the
+// whole list with an exchange and pushes the rest back, so a node is
+// never read after another thread may have taken it (no ABA). A thread
+// popping while the list is detached finds it empty and falls back to
+// arinit.
+#define AR_IDLE_SLOTS (AR_NUMA_NODES + 1)
+
+static Arena *ar_idle[AR_NTYPES][AR_IDLE_SLOTS];
+static int ar_thread_numa;
+
+static __thread Arena *ar_thread_arenas[AR_NTYPES];
+static pthread_key_t ar_thread_key;
+static pthread_once_t ar_thread_once = PTHREAD_ONCE_INIT;
+
+// pushes the list first..last onto the idle list <slot> of <type>
+void ar_idle_push(ArenaType type, int slot, Arena *first, Arena *last) {
+	Arena **list = &ar_idle[type][slot];
+	Arena *head = __atomic_load_n(list, __ATOMIC_RELAXED);
+
+	do {
+		last->idle_next = head;
+	} while (!__atomic_compare_exchange_n(list, &head, first, 1,
+					      __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
+
+Arena *ar_idle_pop(ArenaType type, int slot) {
+	Arena *list = __atomic_exchange_n(&ar_idle[type][slot], NULL, __ATOMIC_ACQUIRE);
+
+	if (!list) return NULL;
+
+	Arena *rest = list->idle_next;
+
+	if (rest) {
+		Arena *last = rest;
+		while (last->idle_next) last = last->idle_next;
+
+		ar_idle_push(type, slot, rest, last);
+	}
+
+	list->idle_next = NULL;
+	return list;
+}
+
+// resets <arena> and hands it to the idle list of its node
+void ar_idle_release(ArenaType type, Arena *arena) {
+	arreset(arena);
+	ar_idle_push(type, arena->numa_node + 1, arena, arena);
+}
+
+// thread exit: hand the thread's arenas to the idle lists
+void ar_thread_exit(void *arenas) {
+	Arena **slots = arenas;
+
+	for (int type = 0; type < AR_NTYPES; type++) {
+		if (!slots[type]) continue;
+
+		ar_idle_release((ArenaType)type, slots[type]);
+		slots[type] = NULL;
+	}
+}
+
+void ar_thread_key_init(void) {
+	pthread_key_create(&ar_thread_key, ar_thread_exit);
+}
+
+void arthread_numa(int enable) {
+	__atomic_store_n(&ar_thread_numa, enable != 0, __ATOMIC_RELAXED);
+}
+
+Arena *arthread_local(ArenaType type) {
+	if (type < 0 || type >= AR_NTYPES) return NULL;
+
+	Arena *arena = ar_thread_arenas[type];
+
+	if (arena) return arena;
+
+	pthread_once(&ar_thread_once, ar_thread_key_init);
+
+	int node = __atomic_load_n(&ar_thread_numa, __ATOMIC_RELAXED) ? ar_numa_node() : -1;
+
+	arena = ar_idle_pop(type, node + 1);
+
+	if (!arena && node >= 0) {
+		ArenaConfig config = { 0 };
+
+		config.type = type;
+		config.flags = AR_NUMA_BIND;
+		config.numa_node = node;
+		arena = arinit_ex(&config);
+	}
+
+	if (!arena) arena = arinit(type);
+	if (!arena) return NULL;
+
+	ar_thread_arenas[type] = arena;
+	pthread_setspecific(ar_thread_key, ar_thread_arenas);
+
+	return arena;
+}
+
+void arthread_release(ArenaType type) {
+	if (type < 0 || type >= AR_NTYPES) return;
+
+	Arena *arena = ar_thread_arenas[type];
+
+	if (!arena) return;
+
+	ar_thread_arenas[type] = NULL;
+	ar_idle_release(type, arena);
+}
+
+void arthread_purge(void) {
+	for (int type = 0; type < AR_NTYPES; type++) {
+		for (int slot = 0; slot < AR_IDLE_SLOTS; slot++) {
+			Arena *list = __atomic_exchange_n(&ar_idle[type][slot], NULL,
+							  __ATOMIC_ACQUIRE);
+
+			while (list) {
+				Arena *next = list->idle_next;
+				arfree(list);
+				list = next;
+			}
+		}
+	}
+}
+
+// THREAD-LOCAL ARENAS
 
 #endif // ARENA_IMPLEMENTATION
 
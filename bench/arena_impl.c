@@ -0,0 +1,3 @@
+// the implementation is C, C++ benches link against this
+#define ARENA_IMPLEMENTATION
+#include "arena.h"
@@ -0,0 +1,331 @@
+// arena.h benchmarks against the system allocator.
+//
+// Link the same file against jemalloc or mimalloc to get those as the
+// malloc baseline, see the Makefile.
+
+#define ARENA_INLINE
+#define ARENA_IMPLEMENTATION
+#include "arena.h"
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifndef BENCH_MALLOC
+#define BENCH_MALLOC "malloc"
+#endif
+
+#define BATCH 4096          // allocations between resets/frees
+#define ROUNDS 2000         // batches per throughput run
+#define GROWTH_ALLOCS 200000
+#define GROWTH_ROUNDS 20
+#define MAX_THREADS 8
+#define MT_ROUNDS 250       // AR_SHARED is never reset, keep it small
+
+static volatile size_t sink;
+
+static uint64_t now_ns(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+// xorshift, sizes for the mixed workload
+static size_t next_size(uint32_t *state) {
+	uint32_t x = *state;
+
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	*state = x;
+
+	return 8 + (x % 505);
+}
+
+// ------------------------------------------
+// Allocators under test: alloc, then release everything of the batch
+// ------------------------------------------
+
+typedef struct {
+	const char *name;
+	void *(*alloc)(void *ctx, size_t size);
+	void (*release)(void *ctx, void **ptrs, size_t n);
+} Allocator;
+
+static void *malloc_alloc(void *ctx, size_t size) {
+	(void)ctx;
+	return malloc(size);
+}
+
+static void malloc_release(void *ctx, void **ptrs, size_t n) {
+	(void)ctx;
+	for (size_t i = 0; i < n; i++) free(ptrs[i]);
+}
+
+static void *arena_alloc(void *ctx, size_t size) {
+	return aralloc((Arena *)ctx, size);
+}
+
+static void *arena_alloc_fast(void *ctx, size_t size) {
+	return aralloc_fast((Arena *)ctx, size);
+}
+
+static void arena_release(void *ctx, void **ptrs, size_t n) {
+	(void)ptrs;
+	(void)n;
+	arreset((Arena *)ctx);
+}
+
+static const Allocator allocators[] = {
+	{ BENCH_MALLOC, malloc_alloc, malloc_release },
+	{ "aralloc", arena_alloc, arena_release },
+	{ "aralloc_fast", arena_alloc_fast, arena_release },
+};
+
+#define NALLOCATORS (sizeof(allocators) / sizeof(allocators[0]))
+
+// ns per allocation over ROUNDS batches, <mixed> picks 8..512 byte sizes
+static double run_batches(const Allocator *a, void *ctx, int mixed, void **ptrs) {
+	uint32_t state = 2463534242u;
+	size_t touched = 0;
+	uint64_t start = now_ns();
+
+	for (int round = 0; round < ROUNDS; round++) {
+		for (size_t i = 0; i < BATCH; i++) {
+			size_t size = mixed ? next_size(&state) : 32;
+			char *p = a->alloc(ctx, size);
+
+			if (!p) {
+				fprintf(stderr, "%s: out of memory\n", a->name);
+				exit(1);
+			}
+
+			p[0] = (char)i;
+			touched += (size_t)p[0];
+			ptrs[i] = p;
+		}
+
+		a->release(ctx, ptrs, BATCH);
+	}
+
+	sink += touched;
+	return (double)(now_ns() - start) / ((double)ROUNDS * BATCH);
+}
+
+static void bench_throughput(void) {
+	void **ptrs = malloc(BATCH * sizeof(void *));
+
+	printf("\n== single thread, %d x %d allocations ==\n", ROUNDS, BATCH);
+	printf("%-14s %12s %12s\n", "allocator", "32B ns/op", "mixed ns/op");
+
+	for (size_t i = 0; i < NALLOCATORS; i++) {
+		Arena *arena = arinit(AR_DYNAMIC);
+
+		double fixed = run_batches(&allocators[i], arena, 0, ptrs);
+		double mixed = run_batches(&allocators[i], arena, 1, ptrs);
+
+		printf("%-14s %12.2f %12.2f\n", allocators[i].name, fixed, mixed);
+		arfree(arena);
+	}
+
+	free(ptrs);
+}
+
+// ------------------------------------------
+// Reset cycles: a short-lived arena per cycle against one kept arena
+// ------------------------------------------
+
+static void bench_reset(void) {
+	const int cycles = 20000;
+	const int per_cycle = 256;
+	uint64_t start;
+
+	printf("\n== reset cycles, %d x %d allocations ==\n", cycles, per_cycle);
+	printf("%-22s %12s\n", "variant", "ns/cycle");
+
+	start = now_ns();
+	for (int c = 0; c < cycles; c++) {
+		Arena *arena = arinit(AR_DYNAMIC);
+
+		for (int i = 0; i < per_cycle; i++) sink += (size_t)aralloc(arena, 64);
+		arfree(arena);
+	}
+	printf("%-22s %12.1f\n", "arinit/arfree", (double)(now_ns() - start) / cycles);
+
+	const ArenaResetMode modes[] = { AR_RESET_KEEP, AR_RESET_TRIM, AR_RESET_COALESCE };
+	const char *names[] = { "arreset", "arreset_ex TRIM 4K", "arreset_ex COALESCE" };
+
+	for (int m = 0; m < 3; m++) {
+		Arena *arena = arinit(AR_DYNAMIC);
+		ArenaResetPolicy policy = { modes[m], AR_PAGE_SIZE };
+
+		start = now_ns();
+		for (int c = 0; c < cycles; c++) {
+			for (int i = 0; i < per_cycle; i++) sink += (size_t)aralloc(arena, 64);
+			arreset_ex(arena, policy);
+		}
+		printf("%-22s %12.1f\n", names[m], (double)(now_ns() - start) / cycles);
+
+		arfree(arena);
+	}
+}
+
+// ------------------------------------------
+// Growth latency: every allocation of a fresh AR_DYNAMIC arena is timed,
+// the slow ones are the chunk expansions
+// ------------------------------------------
+
+static int cmp_u64(const void *a, const void *b) {
+	uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+
+	return (x > y) - (x < y);
+}
+
+static void print_latency(const char *name, uint64_t *samples, size_t n) {
+	qsort(samples, n, sizeof(*samples), cmp_u64);
+
+	printf("%-14s %8llu %8llu %8llu %10llu\n", name,
+	       (unsigned long long)samples[n / 2],
+	       (unsigned long long)samples[n * 99 / 100],
+	       (unsigned long long)samples[n * 999 / 1000],
+	       (unsigned long long)samples[n - 1]);
+}
+
+static void bench_growth(void) {
+	size_t n = (size_t)GROWTH_ALLOCS * GROWTH_ROUNDS;
+	uint64_t *samples = malloc(n * sizeof(*samples));
+	void **ptrs = malloc(GROWTH_ALLOCS * sizeof(void *));
+
+	printf("\n== growth latency, %d fresh arenas x %d x 64B, ns ==\n",
+	       GROWTH_ROUNDS, GROWTH_ALLOCS);
+	printf("%-14s %8s %8s %8s %10s\n", "allocator", "p50", "p99", "p999", "max");
+
+	for (size_t i = 0; i < NALLOCATORS; i++) {
+		const Allocator *a = &allocators[i];
+		size_t k = 0;
+
+		// freed chunks would come back warm from the cache
+		arcache_limit(0);
+
+		for (int round = 0; round < GROWTH_ROUNDS; round++) {
+			Arena *arena = arinit(AR_DYNAMIC);
+
+			for (size_t j = 0; j < GROWTH_ALLOCS; j++) {
+				uint64_t t0 = now_ns();
+				char *p = a->alloc(arena, 64);
+
+				p[0] = 1;
+				samples[k++] = now_ns() - t0;
+				ptrs[j] = p;
+			}
+
+			a->release(arena, ptrs, GROWTH_ALLOCS);
+			arfree(arena);
+		}
+
+		arcache_limit(ARENA_CACHE_MAX);
+		print_latency(a->name, samples, n);
+	}
+
+	free(ptrs);
+	free(samples);
+}
+
+// ------------------------------------------
+// Multi-thread scaling: malloc, a thread-local arena per thread and
+// one AR_SHARED arena for all
+// ------------------------------------------
+
+enum { MT_MALLOC, MT_THREAD_LOCAL, MT_SHARED };
+
+typedef struct {
+	int kind;
+	Arena *shared;
+	pthread_barrier_t *barrier;
+} Worker;
+
+static void *mt_worker(void *arg) {
+	Worker *w = arg;
+	void **ptrs = malloc(BATCH * sizeof(void *));
+	size_t touched = 0;
+
+	pthread_barrier_wait(w->barrier);
+
+	for (int round = 0; round < MT_ROUNDS; round++) {
+		Arena *arena = w->kind == MT_THREAD_LOCAL ? arthread_local(AR_DYNAMIC) : w->shared;
+
+		for (size_t i = 0; i < BATCH; i++) {
+			char *p = w->kind == MT_MALLOC ? malloc(32) : aralloc(arena, 32);
+
+			p[0] = (char)i;
+			touched += (size_t)p[0];
+			ptrs[i] = p;
+		}
+
+		if (w->kind == MT_MALLOC) malloc_release(NULL, ptrs, BATCH);
+		else if (w->kind == MT_THREAD_LOCAL) arreset(arena);
+	}
+
+	if (w->kind == MT_THREAD_LOCAL) arthread_release(AR_DYNAMIC);
+
+	sink += touched;
+	free(ptrs);
+	return NULL;
+}
+
+static double run_threads(int kind, int nthreads) {
+	pthread_t threads[MAX_THREADS];
+	Worker workers[MAX_THREADS];
+	pthread_barrier_t barrier;
+	Arena *shared = kind == MT_SHARED ? arinit(AR_SHARED) : NULL;
+
+	pthread_barrier_init(&barrier, NULL, (unsigned)nthreads + 1);
+
+	for (int i = 0; i < nthreads; i++) {
+		workers[i].kind = kind;
+		workers[i].shared = shared;
+		workers[i].barrier = &barrier;
+		pthread_create(&threads[i], NULL, mt_worker, &workers[i]);
+	}
+
+	uint64_t start = now_ns();
+
+	pthread_barrier_wait(&barrier);
+	for (int i = 0; i < nthreads; i++) pthread_join(threads[i], NULL);
+
+	double secs = (double)(now_ns() - start) / 1e9;
+
+	pthread_barrier_destroy(&barrier);
+	arfree(shared);
+
+	return (double)nthreads * MT_ROUNDS * BATCH / secs / 1e6;
+}
+
+static void bench_threads(void) {
+	printf("\n== multi thread, 32B allocations, Mops/s ==\n");
+	printf("%-8s %12s %14s %12s\n", "threads", BENCH_MALLOC, "arthread_local", "AR_SHARED");
+
+	for (int n = 1; n <= MAX_THREADS; n *= 2) {
+		printf("%-8d %12.1f %14.1f %12.1f\n", n,
+		       run_threads(MT_MALLOC, n),
+		       run_threads(MT_THREAD_LOCAL, n),
+		       run_threads(MT_SHARED, n));
+	}
+
+	arthread_purge();
+}
+
+int main(int argc, char **argv) {
+	const char *only = argc > 1 ? argv[1] : NULL;
+
+	if (!only || !strcmp(only, "throughput")) bench_throughput();
+	if (!only || !strcmp(only, "reset")) bench_reset();
+	if (!only || !strcmp(only, "growth")) bench_growth();
+	if (!only || !strcmp(only, "threads")) bench_threads();
+
+	return 0;
+}
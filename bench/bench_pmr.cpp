@@ -0,0 +1,115 @@
+// ArenaResource against the standard pmr resources, links arena_impl.o
+
+#include "arena.h"
+
+#include <chrono>
+#include <cstdio>
+#include <memory_resource>
+#include <string>
+#include <vector>
+
+static volatile size_t sink;
+
+static const int ROUNDS = 2000;
+static const int BATCH = 4096;
+
+static double now_ns() {
+	using namespace std::chrono;
+
+	return (double)duration_cast<nanoseconds>(
+		steady_clock::now().time_since_epoch()).count();
+}
+
+// raw 32B allocations, <release> drops the whole batch
+template <class Release>
+static double run_raw(std::pmr::memory_resource *res, Release release) {
+	double start = now_ns();
+
+	for (int round = 0; round < ROUNDS; round++) {
+		for (int i = 0; i < BATCH; i++) {
+			char *p = static_cast<char *>(res->allocate(32, 16));
+
+			p[0] = (char)i;
+			sink += (size_t)p[0];
+		}
+
+		release();
+	}
+
+	return (now_ns() - start) / ((double)ROUNDS * BATCH);
+}
+
+// a vector of short strings built and dropped per round
+template <class Release>
+static double run_containers(std::pmr::memory_resource *res, Release release) {
+	const int rounds = ROUNDS / 10;
+	double start = now_ns();
+
+	for (int round = 0; round < rounds; round++) {
+		{
+			std::pmr::vector<std::pmr::string> names(res);
+
+			for (int i = 0; i < BATCH; i++)
+				names.emplace_back("a string past the small buffer", (size_t)(16 + i % 16));
+
+			sink += names.size();
+		}
+
+		release();
+	}
+
+	return (now_ns() - start) / ((double)rounds * BATCH);
+}
+
+int main() {
+	std::printf("%-26s %12s %16s\n", "resource", "32B ns/op", "strings ns/op");
+
+	{
+		std::pmr::memory_resource *res = std::pmr::new_delete_resource();
+		std::vector<void *> ptrs;
+
+		// new_delete has no release, free through the vector instead
+		double start = now_ns();
+
+		for (int round = 0; round < ROUNDS; round++) {
+			for (int i = 0; i < BATCH; i++) {
+				char *p = static_cast<char *>(res->allocate(32, 16));
+
+				p[0] = (char)i;
+				ptrs.push_back(p);
+			}
+
+			for (void *p : ptrs) res->deallocate(p, 32, 16);
+			ptrs.clear();
+		}
+
+		double raw = (now_ns() - start) / ((double)ROUNDS * BATCH);
+
+		std::printf("%-26s %12.2f %16.2f\n", "new_delete_resource", raw,
+			    run_containers(res, [] {}));
+	}
+
+	{
+		std::pmr::monotonic_buffer_resource res;
+		auto release = [&res] { res.release(); };
+
+		double raw = run_raw(&res, release);
+
+		std::printf("%-26s %12.2f %16.2f\n", "monotonic_buffer_resource", raw,
+			    run_containers(&res, release));
+	}
+
+	{
+		Arena *arena = arinit(AR_DYNAMIC);
+		ArenaResource res(arena);
+		auto release = [arena] { arreset(arena); };
+
+		double raw = run_raw(&res, release);
+
+		std::printf("%-26s %12.2f %16.2f\n", "ArenaResource", raw,
+			    run_containers(&res, release));
+		arfree(arena);
+	}
+
+	return 0;
+}
@@ -0,0 +1,39 @@
+// CHECK and the runner shared by the test programs, see the Makefile.
+//
+// Each test_* function checks one area and keeps going on failure, the
+// run exits non-zero if any CHECK failed.
+
+#ifndef ARENA_TEST_CHECK_H
+#define ARENA_TEST_CHECK_H
+
+#include <stdio.h>
+#include <stdlib.h>
+
+static int failures;
+
+#define CHECK(cond) do { \
+	if (!(cond)) { \
+		fprintf(stderr, "%s:%d: %s\n", __FILE__, __LINE__, #cond); \
+		failures++; \
+	} \
+} while (0)
+
+struct test {
+	const char *name;
+	void (*run)(void);
+};
+
+static int run_tests(const struct test *tests, size_t count) {
+	for (size_t i = 0; i < count; i++) {
+		int before = failures;
+
+		tests[i].run();
+		printf("%-20s %s\n", tests[i].name, failures == before ? "ok" : "FAIL");
+	}
+
+	return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+#define RUN_TESTS(tests) run_tests((tests), sizeof(tests) / sizeof((tests)[0]))
+
+#endif // ARENA_TEST_CHECK_H
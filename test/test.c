@@ -0,0 +1,1073 @@
+// arena.h correctness tests, see the Makefile and check.h.
+//
+// Tests reach into struct Arena and struct Chunk through ARENA_INLINE
+// where the public API can't tell.
+
+#define ARENA_STATS
+#define ARENA_INLINE
+#define ARENA_IMPLEMENTATION
+#include "arena.h"
+
+#include "check.h"
+
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+
+static size_t chain_length(Arena *arena) {
+	size_t n = 0;
+
+	for (struct Chunk *chunk = arena->head; chunk; chunk = chunk->next) n++;
+
+	return n;
+}
+
+static size_t large_count(Arena *arena) {
+	size_t n = 0;
+
+	for (struct Chunk *chunk = arena->large; chunk; chunk = chunk->next) n++;
+
+	return n;
+}
+
+static int all_zero(const unsigned char *p, size_t n) {
+	for (size_t i = 0; i < n; i++)
+		if (p[i]) return 0;
+
+	return 1;
+}
+
+static void fill(Arena *arena, size_t count, size_t size, int byte) {
+	for (size_t i = 0; i < count; i++) {
+		void *p = aralloc(arena, size);
+
+		CHECK(p != NULL);
+		if (p) memset(p, byte, size);
+	}
+}
+
+static void test_reset_policies(void) {
+	ArenaStats stats;
+
+	// KEEP holds on to every chunk and starts over in the head
+	Arena *arena = arinit(AR_DYNAMIC);
+
+	fill(arena, 200, 1000, 1);
+	size_t chunks = chain_length(arena);
+	size_t total = arena->total;
+
+	CHECK(chunks > 3);
+	arreset(arena);
+	CHECK(arena->curr == arena->head && chain_length(arena) == chunks);
+	CHECK(arena->total == total);
+	fill(arena, 200, 1000, 2);
+	CHECK(chain_length(arena) == chunks);
+
+	// TRIM to 0 keeps only the head
+	ArenaResetPolicy trim = { AR_RESET_TRIM, 0 };
+
+	arreset_ex(arena, trim);
+	CHECK(chain_length(arena) == 1 && arena->total == arena->head->capacity);
+
+	// COALESCE leaves the head and one chunk as large as the rest
+	fill(arena, 200, 1000, 3);
+	total = arena->total;
+
+	ArenaResetPolicy coalesce = { AR_RESET_COALESCE, 0 };
+
+	arreset_ex(arena, coalesce);
+	CHECK(chain_length(arena) == 2 && arena->total >= total);
+	fill(arena, 200, 1000, 4);
+	CHECK(chain_length(arena) == 2);
+	arfree(arena);
+
+	// ADAPTIVE keeps what a steady workload needs, nothing is remapped
+	ArenaResetPolicy adaptive = { AR_RESET_ADAPTIVE, 0 };
+
+	arena = arinit(AR_DYNAMIC);
+
+	for (int i = 0; i < 8; i++) {
+		fill(arena, 160, 64, 5);
+		arreset_ex(arena, adaptive);
+	}
+
+	arstats(arena, &stats);
+	CHECK(stats.expansions == 1);
+
+	// and shrinks once the window forgets the larger cycles
+	for (int i = 0; i < 20; i++) {
+		fill(arena, 1, 64, 6);
+		arreset_ex(arena, adaptive);
+	}
+
+	CHECK(chain_length(arena) == 1);
+	arfree(arena);
+
+	// AR_FIXED trimming leaves the partial last page dirty
+	ArenaConfig fixed = { 0 };
+
+	fixed.type = AR_FIXED;
+	fixed.initial_size = 100000;
+	fixed.max_size = 100000;
+	arena = arinit_ex(&fixed);
+
+	size_t capacity = arena->head->capacity;
+
+	CHECK(capacity == 100000 - 100000 % AR_ALIGN);
+	CHECK((uintptr_t)(arena->head->memory + arena->head->reserved) % AR_PAGE_SIZE == 0);
+	memset(aralloc(arena, capacity), 0x5a, capacity);
+	arreset_ex(arena, trim);
+	CHECK(aralloc(arena, capacity - 48) != NULL);
+
+	unsigned char *tail = arcalloc(arena, 1, 32);
+
+	CHECK(tail && all_zero(tail, 32));
+	arfree(arena);
+
+	// the guard page follows the whole pages of a max_size mapping
+	fixed.flags = AR_GUARD_PAGES;
+	arena = arinit_ex(&fixed);
+	CHECK(arena && arena->head->capacity == capacity);
+	CHECK(arena && (uintptr_t)(arena->head->memory + arena->head->reserved) % AR_PAGE_SIZE == 0);
+	arfree(arena);
+
+	// AR_VIRTUAL trims by decommitting
+	arena = arinit(AR_VIRTUAL);
+	fill(arena, 1000, 1000, 7);
+
+	size_t committed = arena->head->capacity;
+
+	arreset_ex(arena, trim);
+	CHECK(arena->head->capacity < committed);
+	fill(arena, 1000, 1000, 8);
+	arfree(arena);
+}
+
+static void test_cache_zeroing(void) {
+	size_t size = 256 << 10;
+
+	// fresh pages need no clearing
+	Arena *arena = arinit(AR_DYNAMIC);
+	unsigned char *p = arcalloc(arena, 1, size);
+
+	CHECK(p && all_zero(p, size));
+
+	// reused bytes do
+	memset(p, 0xab, size);
+	arreset(arena);
+	p = arcalloc(arena, 1, size);
+	CHECK(p && all_zero(p, size));
+	arfree(arena);
+
+	// a freed arena's chunks are reused by the next one of that size,
+	// its old contents never show through arcalloc. Cache buckets are
+	// powers of two, this maps exactly 512KB.
+	ArenaConfig config = { 0 };
+
+	config.type = AR_DYNAMIC;
+	config.initial_size = (2 * size) - 4096;
+	arena = arinit_ex(&config);
+
+	struct Chunk *head = arena->head;
+
+	memset(aralloc(arena, size), 0xcd, size);
+	arfree(arena);
+	arena = arinit_ex(&config);
+	CHECK(arena->head == head);
+	p = arcalloc(arena, 1, size);
+	CHECK(p && all_zero(p, size));
+	arfree(arena);
+
+	// arcalloc in the middle of a used chunk
+	arena = arinit(AR_DYNAMIC);
+	fill(arena, 4, 100, 0xee);
+	arreset(arena);
+	aralloc(arena, 24);
+	p = arcalloc(arena, 10, 37);
+	CHECK(p && all_zero(p, 370));
+	CHECK(arcalloc(arena, (size_t)-1, 2) == NULL);
+	arfree(arena);
+}
+
+static void test_hugepages(void) {
+	ArenaConfig config = { 0 };
+
+	config.type = AR_DYNAMIC;
+	config.initial_size = (2 << 20) - 4096;
+	config.flags = AR_HUGEPAGES;
+
+	Arena *arena = arinit_ex(&config);
+
+	CHECK(arena != NULL);
+	if (!arena) return;
+
+	// no huge pages reserved on this machine, nothing to check
+	if (arhuge_bytes(arena) == 0) {
+		arfree(arena);
+		return;
+	}
+
+	memset(aralloc(arena, 1 << 20), 0xab, 1 << 20);
+	arfree(arena);
+
+	// MAP_HUGETLB chunks never reach the cache with their contents
+	ArenaConfig plain = { 0 };
+
+	plain.type = AR_DYNAMIC;
+	plain.initial_size = (1 << 20) + 300000;
+	arena = arinit_ex(&plain);
+
+	unsigned char *p = arcalloc(arena, 1, 1 << 20);
+
+	CHECK(p && all_zero(p, 1 << 20));
+	CHECK(arhuge_bytes(arena) == 0);
+	arfree(arena);
+
+	// first chunks of any size past 2MB are rounded up to huge pages
+	config.initial_size = 2 << 20;
+	arena = arinit_ex(&config);
+	CHECK(arena && arhuge_bytes(arena) >= (2u << 20));
+	arfree(arena);
+
+	ArenaConfig fixed = config;
+
+	fixed.type = AR_FIXED;
+	fixed.initial_size = 4 << 20;
+	arena = arinit_ex(&fixed);
+	CHECK(arena && arhuge_bytes(arena) >= (4u << 20));
+	arfree(arena);
+
+	// large allocations are rounded to huge pages too
+	arena = arinit_ex(&config);
+	CHECK(aralloc(arena, 8 << 20) != NULL);
+	CHECK(arena->large && chunk_span(arena->large) % (2 << 20) == 0);
+	CHECK(arhuge_bytes(arena) >= (8u << 20));
+	arfree(arena);
+}
+
+static void test_file_arenas(void) {
+	char path[] = "/tmp/arena_test_XXXXXX";
+	int fd = mkstemp(path);
+
+	CHECK(fd >= 0);
+	if (fd < 0) return;
+
+	close(fd);
+	unlink(path);
+
+	// written once, found again on the next open
+	Arena *arena = arinit_file(path, 1 << 16, 0);
+
+	CHECK(arena != NULL);
+	if (!arena) return;
+
+	char *name = aralloc_aligned(arena, 51, 1);
+
+	strcpy(name, "root");
+	CHECK(arroot_set(arena, name) == 0);
+	CHECK(arptr(arena, aroffset(arena, name)) == name);
+	CHECK(arsync(arena) == 0);
+	arfree(arena);
+
+	// read-only: nothing fits, reset changes nothing
+	arena = arinit_file(path, 0, AR_READONLY);
+	CHECK(arena != NULL);
+	if (!arena) return;
+
+	CHECK(arroot_get(arena) && strcmp(arroot_get(arena), "root") == 0);
+	CHECK(aralloc_fast(arena, 8) == NULL);
+	CHECK(aralloc(arena, 1) == NULL);
+	CHECK(aralloc_aligned(arena, 8, 1) == NULL);
+	CHECK(arreserve(arena, 8) == -1);
+	CHECK(arrealloc(arena, arroot_get(arena), 51, 8) == NULL);
+	CHECK(aralloc_fast(arena, 8) == NULL);
+	CHECK(arroot_set(arena, NULL) == -1);
+	CHECK(arsync(arena) == -1);
+	arreset(arena);
+	CHECK(aralloc(arena, 8) == NULL);
+	CHECK(arroot_get(arena) && strcmp(arroot_get(arena), "root") == 0);
+	arfree(arena);
+
+	// reset and rewind drop a root they free
+	arena = arinit_file(path, 0, 0);
+	CHECK(arroot_get(arena) != NULL);
+	arreset(arena);
+	CHECK(arroot_get(arena) == NULL);
+
+	char *kept = aralloc(arena, 64);
+	ArenaMark mark = armark(arena);
+
+	CHECK(arroot_set(arena, aralloc(arena, 64)) == 0);
+	arrewind(arena, mark);
+	CHECK(arroot_get(arena) == NULL);
+	CHECK(arroot_set(arena, kept) == 0);
+	arrewind(arena, mark);
+	CHECK(arroot_get(arena) == kept);
+	arfree(arena);
+
+	// only file arenas are read-only
+	ArenaConfig config = { 0 };
+
+	config.type = AR_DYNAMIC;
+	config.flags = AR_READONLY;
+	CHECK(arinit_ex(&config) == NULL);
+
+	// not an arena file
+	CHECK(arinit_file("/dev/null", 0, AR_READONLY) == NULL);
+	unlink(path);
+}
+
+static Arena *shared;
+
+static void *shared_worker(void *unused) {
+	(void)unused;
+
+	for (int i = 0; i < 200; i++) {
+		char *p = aralloc(shared, i % 10 == 0 ? 1 << 20 : 100);
+
+		CHECK(p != NULL);
+		if (p) memset(p, 1, 100);
+	}
+
+	return NULL;
+}
+
+static void test_large(void) {
+	ArenaStats stats;
+	Arena *arena = arinit(AR_DYNAMIC);
+	char *small = aralloc(arena, 100);
+	struct Chunk *curr = arena->curr;
+	size_t total = arena->total;
+
+	// off the chain: curr and its free tail stay
+	char *big = aralloc(arena, 4 << 20);
+
+	CHECK(big != NULL);
+	memset(big, 7, 4 << 20);
+	CHECK(arena->curr == curr && chain_length(arena) == 1 && large_count(arena) == 1);
+	CHECK(aralloc(arena, 100) == small + 112);
+
+	arstats(arena, &stats);
+	CHECK(stats.chunks == 2 && stats.allocated >= (4u << 20));
+
+	// rewind releases the ones after the mark, reset all of them
+	ArenaMark mark = armark(arena);
+	int *zeros = arcalloc(arena, 1 << 20, sizeof(int));
+
+	CHECK(zeros && all_zero((unsigned char *)zeros, 4 << 20));
+	CHECK(large_count(arena) == 2);
+	arrewind(arena, mark);
+	CHECK(large_count(arena) == 1);
+	arreset(arena);
+	CHECK(large_count(arena) == 0 && arena->total == total);
+
+	// their mappings come back from the cache, still zeroed
+	zeros = arcalloc(arena, 1 << 20, sizeof(int));
+	CHECK(zeros && all_zero((unsigned char *)zeros, 4 << 20));
+	arfree(arena);
+
+	// explicit threshold, and turned off
+	ArenaConfig config = { 0 };
+
+	config.type = AR_DYNAMIC;
+	config.large_size = (size_t)-1;
+	arena = arinit_ex(&config);
+	memset(aralloc(arena, 4 << 20), 0, 1);
+	CHECK(large_count(arena) == 0 && chain_length(arena) == 2);
+	arfree(arena);
+
+	config.large_size = 8192;
+	arena = arinit_ex(&config);
+	fill(arena, 3, 1000, 1);
+	CHECK(aralloc(arena, 10000) != NULL && large_count(arena) == 1);
+	arfree(arena);
+
+	// max_size counts them
+	config.large_size = 0;
+	config.max_size = 1 << 20;
+	arena = arinit_ex(&config);
+	CHECK(aralloc(arena, 2 << 20) == NULL);
+	arfree(arena);
+
+	// AR_SHARED, from several threads
+	pthread_t threads[4];
+
+	shared = arinit(AR_SHARED);
+
+	for (int i = 0; i < 4; i++) pthread_create(&threads[i], NULL, shared_worker, NULL);
+	for (int i = 0; i < 4; i++) pthread_join(threads[i], NULL);
+
+	CHECK(large_count(shared) == 80);
+	arreset(shared);
+	CHECK(large_count(shared) == 0);
+	arfree(shared);
+}
+
+static void wait_spare(Arena *arena) {
+	for (int i = 0; i < 2000 && !__atomic_load_n(&arena->spare, __ATOMIC_ACQUIRE); i++)
+		usleep(1000);
+}
+
+static void test_refill(void) {
+	ArenaConfig config = { 0 };
+	ArenaStats stats;
+
+	config.type = AR_DYNAMIC;
+	config.initial_size = 60000;
+	config.flags = AR_REFILL | AR_PREFAULT;
+
+	Arena *arena = arinit_ex(&config);
+
+	CHECK(arena != NULL);
+	if (!arena) return;
+
+	// armed: the capacity is cut to the threshold, arstats sees through it
+	struct Chunk *head = arena->curr;
+	size_t capacity = arena->refill_capacity;
+
+	CHECK(arena->refill_chunk == head && head->capacity < capacity);
+	arstats(arena, &stats);
+	CHECK(stats.committed == capacity);
+
+	// a reservation below the threshold doesn't fire it
+	CHECK(arreserve(arena, 64) == 0);
+	CHECK(arena->refill_chunk == head && !arena->spare);
+
+	// crossing it restores the capacity and asks the helper
+	while (arena->refill_chunk) fill(arena, 1, 100, 1);
+
+	CHECK(arena->curr == head && head->capacity == capacity);
+	wait_spare(arena);
+
+	struct Chunk *spare = arena->spare;
+
+	CHECK(spare != NULL);
+
+	// growth links the helper's chunk and arms it in turn
+	while (arena->curr == head) fill(arena, 1, 100, 2);
+
+	CHECK(arena->curr == spare && chain_length(arena) == 2);
+	CHECK(!arena->spare && arena->refill_chunk == spare);
+
+	// contents survive many refills
+	static char *ptrs[20000];
+
+	for (int i = 0; i < 20000; i++) {
+		ptrs[i] = aralloc(arena, 200);
+		memset(ptrs[i], i & 0xff, 200);
+	}
+
+	int intact = 1;
+
+	for (int i = 0; i < 20000; i++)
+		for (int j = 0; j < 200; j++)
+			if ((unsigned char)ptrs[i][j] != (i & 0xff)) intact = 0;
+
+	CHECK(intact);
+	arstats(arena, &stats);
+	CHECK(stats.committed == arena->total);
+
+	// in-place growth across the threshold
+	char *grown = aralloc(arena, 16);
+
+	for (int i = 0; i < 5000; i++)
+		grown = arrealloc(arena, grown, 16 + (size_t)i * 8, 16 + (size_t)(i + 1) * 8);
+
+	CHECK(grown != NULL);
+
+	// retained chunks come before refills, a trimmed arena arms again
+	arreset(arena);
+	CHECK(!arena->refill_chunk);
+
+	ArenaResetPolicy trim = { AR_RESET_TRIM, 0 };
+
+	arreset_ex(arena, trim);
+	CHECK(chain_length(arena) == 1 && !arena->spare);
+	arfree(arena);
+
+	// arfree with a refill in flight
+	for (int i = 0; i < 50; i++) {
+		arena = arinit_ex(&config);
+		while (arena->refill_chunk) aralloc(arena, 64);
+		arfree(arena);
+	}
+
+	config.refill_percent = 101;
+	CHECK(arinit_ex(&config) == NULL);
+
+	// AR_DYNAMIC only
+	config.refill_percent = 0;
+	config.type = AR_SHARED;
+	arena = arinit_ex(&config);
+	CHECK(arena && !arena->refill_chunk);
+	arfree(arena);
+}
+
+static void test_mark_rewind(void) {
+	for (int type = AR_FIXED; type <= AR_SHARED; type++) {
+		Arena *arena = arinit((ArenaType)type);
+		char *base = aralloc(arena, 16);
+		ArenaMark mark = armark(arena);
+
+		fill(arena, 100, 100, 1);
+
+		ArenaMark inner = armark(arena);
+		char *big = aralloc(arena, 1 << 20);
+
+		// AR_FIXED has no room for it
+		CHECK((big != NULL) == (type != AR_FIXED));
+		if (big) memset(big, 3, 1 << 20);
+
+		// marks unwind innermost first, back to where they were taken
+		arrewind(arena, inner);
+		arrewind(arena, mark);
+		CHECK(aralloc(arena, 16) == base + 16);
+		CHECK(type == AR_FIXED || type == AR_VIRTUAL || large_count(arena) == 0);
+		arfree(arena);
+	}
+}
+
+static void test_aligned(void) {
+	static const size_t aligns[] = { 1, 8, 64, 4096 };
+
+	for (int type = AR_FIXED; type <= AR_SHARED; type++) {
+		Arena *arena = arinit((ArenaType)type);
+		int aligned = 1;
+
+		for (size_t i = 0; i < 200; i++) {
+			size_t align = aligns[i % 4];
+			size_t size = (i * 37) % 300;
+			char *p = aralloc_aligned(arena, size, align);
+
+			// AR_FIXED runs out
+			if (!p) {
+				CHECK(type == AR_FIXED);
+				break;
+			}
+
+			if ((uintptr_t)p & (align - 1)) aligned = 0;
+			memset(p, 1, size);
+		}
+
+		CHECK(aligned);
+		CHECK(aralloc_aligned(arena, 8, 3) == NULL);
+		CHECK(aralloc_aligned(arena, 8, 0) == NULL);
+
+		// small alignments pack, AR_SHARED rounds to 16
+		char *a = aralloc_aligned(arena, 1, 1);
+		char *b = aralloc_aligned(arena, 1, 1);
+
+		if (a && b) CHECK(b == a + (type == AR_SHARED ? 16 : 1));
+		arfree(arena);
+	}
+
+	// past a page
+	Arena *arena = arinit(AR_DYNAMIC);
+	char *p = aralloc_aligned(arena, 100, 1 << 20);
+
+	CHECK(p && ((uintptr_t)p & ((1 << 20) - 1)) == 0);
+	arfree(arena);
+}
+
+static void test_realloc(void) {
+	for (int type = AR_FIXED; type <= AR_SHARED; type++) {
+		Arena *arena = arinit((ArenaType)type);
+
+		// AR_SHARED copies on every growth
+		size_t step = type == AR_SHARED ? 1000 : 1;
+		char *buf = NULL;
+		size_t len = 0;
+		int moves = 0;
+		int intact = 1;
+
+		while (len < 20000) {
+			char *next = arrealloc(arena, buf, len, len + step);
+
+			CHECK(next != NULL);
+			if (!next) break;
+
+			if (next != buf) moves++;
+			for (size_t i = len; i < len + step; i++) next[i] = (char)i;
+
+			buf = next;
+			len += step;
+		}
+
+		for (size_t i = 0; i < len; i++)
+			if (buf[i] != (char)i) intact = 0;
+
+		CHECK(intact);
+
+		// the last allocation grows in place while the chunk has room
+		if (type == AR_FIXED || type == AR_VIRTUAL) CHECK(moves == 1);
+		if (type == AR_DYNAMIC) CHECK(moves < 12);
+
+		// and shrinks in place, giving the bytes back
+		char *last = aralloc(arena, 100);
+
+		CHECK(arrealloc(arena, last, 100, 20) == last);
+		if (type != AR_SHARED) CHECK(aralloc(arena, 16) == last + 32);
+
+		// any other allocation moves to grow, with its contents
+		memset(last, 9, 20);
+
+		char *moved = arrealloc(arena, last, 20, 200);
+
+		CHECK(moved && moved != last && moved[19] == 9);
+
+		// a failed resize leaves it alone
+		if (moved) {
+			CHECK(arrealloc(arena, moved, 200, (size_t)-1 / 2) == NULL);
+			CHECK(moved[19] == 9);
+		}
+
+		arfree(arena);
+	}
+}
+
+static void test_batch(void) {
+	static void *out[1000];
+	Arena *arena = arinit(AR_DYNAMIC);
+	char *first = aralloc_batch(arena, 24, 1000, out);
+	int spaced = 1;
+
+	CHECK(first != NULL);
+
+	for (int i = 0; first && i < 1000; i++) {
+		if (out[i] != first + 32 * i) spaced = 0;
+		else memset(out[i], 1, 24);
+	}
+
+	CHECK(spaced);
+
+	// <out> is left alone on failure
+	out[0] = NULL;
+	CHECK(aralloc_batch(arena, 8, 0, out) == NULL && !out[0]);
+	CHECK(aralloc_batch(arena, (size_t)1 << 40, (size_t)1 << 40, out) == NULL && !out[0]);
+
+	// the next allocation follows the batch
+	char *three = aralloc_batch(arena, 5, 3, NULL);
+
+	CHECK(three && aralloc(arena, 1) == three + 48);
+	arfree(arena);
+
+	// all or nothing
+	arena = arinit(AR_FIXED);
+	CHECK(aralloc_batch(arena, 1024, 1000, NULL) == NULL && arena->curr->offset == 0);
+	arfree(arena);
+}
+
+typedef struct { double x, y; } Point;
+typedef ArenaVec(Point) PointVec;
+
+static void test_containers(void) {
+	for (int type = AR_FIXED; type <= AR_SHARED; type++) {
+		Arena *arena = arinit((ArenaType)type);
+		PointVec vec = { 0 };
+		int intact = 1;
+
+		for (int i = 0; i < 3000; i++) {
+			Point p = { i, 2 * i };
+
+			if (arvec_push(arena, &vec, p) != 0) {
+				CHECK(type == AR_FIXED);
+				break;
+			}
+		}
+
+		for (size_t i = 0; i < vec.len; i++)
+			if (vec.data[i].x != (double)i || vec.data[i].y != (double)(2 * i)) intact = 0;
+
+		CHECK(intact && vec.len > 0);
+
+		size_t len = vec.len;
+		Point last = arvec_pop(&vec);
+
+		CHECK(last.x == (double)(len - 1) && vec.len == len - 1);
+		arvec_clear(&vec);
+		CHECK(vec.len == 0 && vec.cap >= len);
+		CHECK(arvec_reserve(arena, &vec, 10) == 0);
+		arfree(arena);
+	}
+
+	Arena *arena = arinit(AR_DYNAMIC);
+	ArenaStr str = { 0 };
+	int appended = 1;
+
+	for (int i = 0; i < 1000; i++)
+		if (arstr_puts(arena, &str, "ab") != 0 || arstr_putc(arena, &str, 'c') != 0)
+			appended = 0;
+
+	CHECK(appended && str.len == 3000 && strlen(str.data) == 3000);
+	CHECK(arstr_append(arena, &str, "xyz", 2) == 0 && strcmp(str.data + 2997, "abcxy") == 0);
+	arfree(arena);
+
+	// a full arena keeps what was appended
+	arena = arinit(AR_FIXED);
+	str = (ArenaStr){ 0 };
+	CHECK(arstr_puts(arena, &str, "kept") == 0);
+	while (aralloc(arena, 1024)) {}
+	while (arstr_putc(arena, &str, 'x') == 0) {}
+	CHECK(strncmp(str.data, "kept", 4) == 0 && strlen(str.data) == str.len);
+	arfree(arena);
+}
+
+static void test_pools(void) {
+	static void *objs[5000];
+	Arena *arena = arinit(AR_DYNAMIC);
+	ArenaPool *pool = arpool_init(arena, 40);
+	int aligned = 1;
+	int intact = 1;
+	int reused = 1;
+
+	CHECK(pool != NULL);
+	if (!pool) return;
+
+	for (int i = 0; i < 5000; i++) {
+		objs[i] = arpool_alloc(pool);
+
+		if (!objs[i] || ((uintptr_t)objs[i] & 15)) aligned = 0;
+		else memset(objs[i], i & 0xff, 40);
+	}
+
+	CHECK(aligned);
+
+	// freed objects come back last in, first out
+	arpool_free(pool, objs[10]);
+	arpool_free(pool, objs[20]);
+	CHECK(arpool_alloc(pool) == objs[20] && arpool_alloc(pool) == objs[10]);
+
+	// the others keep their contents, the freed ones are handed out again
+	for (int i = 0; i < 5000; i += 2) arpool_free(pool, objs[i]);
+
+	for (int i = 1; i < 5000; i += 2)
+		for (int k = 0; k < 40; k++)
+			if (((unsigned char *)objs[i])[k] != (i & 0xff)) intact = 0;
+
+	for (int i = 0; i < 2500; i++) {
+		void *obj = arpool_alloc(pool);
+		int found = 0;
+
+		for (int j = 0; j < 5000; j += 2)
+			if (objs[j] == obj) found = 1;
+
+		if (!found) reused = 0;
+	}
+
+	CHECK(intact && reused);
+
+	// small objects still hold the free list link
+	ArenaPool *tiny = arpool_init(arena, 3);
+	char *a = arpool_alloc(tiny);
+	char *b = arpool_alloc(tiny);
+
+	CHECK(a && b && b - a == 8);
+
+	arpool_free(pool, NULL);
+	CHECK(arpool_init(arena, 0) == NULL);
+	CHECK(arpool_alloc(NULL) == NULL);
+	arfree(arena);
+}
+
+static void test_rings(void) {
+	ArenaRing ring;
+	int *prev = NULL;
+	int intact = 1;
+
+	CHECK(arring_init(&ring, AR_DYNAMIC, 1) == -1);
+	CHECK(arring_init(&ring, AR_DYNAMIC, AR_RING_MAX + 1) == -1);
+	CHECK(arring_init(&ring, AR_DYNAMIC, 3) == 0);
+
+	// the previous generation outlives the one after it
+	for (int frame = 0; frame < 100; frame++) {
+		Arena *arena = arring_advance(&ring);
+		int *curr = aralloc(arena, 1000 * sizeof(int));
+
+		CHECK(arena == arring_current(&ring) && arring_get(&ring, 0) == arena);
+		CHECK(arring_get(&ring, 2) != arena && arring_get(&ring, 3) == NULL);
+
+		for (int i = 0; i < 1000; i++) curr[i] = frame;
+
+		if (prev)
+			for (int i = 0; i < 1000; i++)
+				if (prev[i] != frame - 1) intact = 0;
+
+		prev = curr;
+	}
+
+	CHECK(intact);
+
+	// the reused arena gets the ring's policy
+	ring.policy.mode = AR_RESET_TRIM;
+	ring.policy.keep = 0;
+	fill(arring_current(&ring), 1000, 100, 1);
+
+	for (int i = 0; i < 3; i++) arring_advance(&ring);
+
+	CHECK(chain_length(arring_current(&ring)) == 1);
+
+	arring_free(&ring);
+	arring_free(&ring);
+	CHECK(arring_current(&ring) == NULL);
+}
+
+static pthread_barrier_t thread_barrier;
+
+static void *thread_local_worker(void *out) {
+	Arena *arena = arthread_local(AR_DYNAMIC);
+	int same = 1;
+
+	*(Arena **)out = arena;
+	if (!arena) return NULL;
+
+	unsigned char *p = aralloc(arena, 4096);
+
+	memset(p, (int)((uintptr_t)arena & 0xff), 4096);
+
+	// every thread holds its own while the others allocate
+	pthread_barrier_wait(&thread_barrier);
+
+	for (int i = 0; i < 100; i++) {
+		if (arthread_local(AR_DYNAMIC) != arena) same = 0;
+		fill(arena, 10, 64, i);
+	}
+
+	pthread_barrier_wait(&thread_barrier);
+
+	for (int i = 0; i < 4096; i++)
+		if (p[i] != ((uintptr_t)arena & 0xff)) same = 0;
+
+	CHECK(same);
+	return NULL;
+}
+
+static void test_thread_local(void) {
+	pthread_t threads[4];
+	Arena *arenas[4];
+
+	pthread_barrier_init(&thread_barrier, NULL, 4);
+
+	for (int i = 0; i < 4; i++)
+		pthread_create(&threads[i], NULL, thread_local_worker, &arenas[i]);
+	for (int i = 0; i < 4; i++) pthread_join(threads[i], NULL);
+
+	pthread_barrier_destroy(&thread_barrier);
+
+	for (int i = 0; i < 4; i++) {
+		CHECK(arenas[i] != NULL);
+
+		for (int j = 0; j < i; j++) CHECK(arenas[i] != arenas[j]);
+	}
+
+	// one per type, a released arena is handed out again
+	Arena *arena = arthread_local(AR_DYNAMIC);
+
+	CHECK(arena && arthread_local(AR_FIXED) != arena);
+	arthread_release(AR_DYNAMIC);
+	CHECK(arthread_local(AR_DYNAMIC) == arena);
+	arthread_release(AR_DYNAMIC);
+	arthread_release(AR_FIXED);
+	arthread_purge();
+}
+
+#define SHARED_THREADS 4
+#define SHARED_ALLOCS 5000
+
+static char *shared_ptrs[SHARED_THREADS][SHARED_ALLOCS];
+
+static void *shared_filler(void *arg) {
+	int id = (int)(intptr_t)arg;
+
+	for (int i = 0; i < SHARED_ALLOCS; i++) {
+		size_t align = i % 5 == 0 ? 64 : 16;
+		char *p = aralloc_aligned(shared, 24, align);
+
+		CHECK(p && ((uintptr_t)p & (align - 1)) == 0);
+		if (!p) return NULL;
+
+		memset(p, id + 1, 24);
+		shared_ptrs[id][i] = p;
+
+		if (i % 50 == 0) CHECK(arreserve(shared, 3000) == 0);
+
+		if (i % 70 == 0) {
+			unsigned char *zeros = arcalloc(shared, 1, 500);
+
+			CHECK(zeros && all_zero(zeros, 500));
+			if (zeros) memset(zeros, 0xff, 500);
+		}
+	}
+
+	return NULL;
+}
+
+static void test_shared(void) {
+	pthread_t threads[SHARED_THREADS];
+
+	shared = arinit(AR_SHARED);
+
+	// no two threads get the same bytes, resets included
+	for (int round = 0; round < 3; round++) {
+		int intact = 1;
+
+		for (int i = 0; i < SHARED_THREADS; i++)
+			pthread_create(&threads[i], NULL, shared_filler, (void *)(intptr_t)i);
+		for (int i = 0; i < SHARED_THREADS; i++) pthread_join(threads[i], NULL);
+
+		for (int t = 0; t < SHARED_THREADS; t++)
+			for (int i = 0; i < SHARED_ALLOCS; i++)
+				for (int k = 0; k < 24; k++)
+					if (shared_ptrs[t][i] && shared_ptrs[t][i][k] != t + 1) intact = 0;
+
+		CHECK(intact);
+		CHECK(chain_length(shared) > 1);
+		arreset(shared);
+	}
+
+	arfree(shared);
+}
+
+static void test_stats(void) {
+	ArenaStats stats;
+	ArenaStats after;
+	Arena *arena = arinit(AR_DYNAMIC);
+
+	CHECK(arstats(NULL, &stats) == -1 && arstats(arena, NULL) == -1);
+
+	fill(arena, 10, 100, 1);
+	aralloc_aligned(arena, 8, 64);
+	arstats(arena, &stats);
+	CHECK(stats.requested == 1008 && stats.allocated == stats.requested + stats.padding);
+	CHECK(stats.chunks == 1 && stats.committed == arena->total && stats.expansions == 0);
+
+	fill(arena, 100, 100, 2);
+	arstats(arena, &stats);
+	CHECK(stats.chunks == chain_length(arena) && stats.expansions == stats.chunks - 1);
+	CHECK(stats.peak == stats.allocated && stats.committed == arena->total);
+	CHECK(stats.allocated + stats.wasted <= stats.committed);
+
+	// rewind restores the counters, reset clears all but the peak
+	ArenaMark mark = armark(arena);
+
+	aralloc(arena, 50);
+	arrewind(arena, mark);
+	arstats(arena, &after);
+	CHECK(after.requested == stats.requested && after.allocated == stats.allocated);
+	CHECK(after.peak > stats.peak);
+
+	arreset(arena);
+	arstats(arena, &stats);
+	CHECK(stats.allocated == 0 && stats.requested == 0 && stats.wasted == 0);
+	CHECK(stats.peak == after.peak && stats.resets == 1 && stats.chunks == after.chunks);
+	arfree(arena);
+}
+
+static uint32_t next_random(uint32_t *state) {
+	*state = *state * 1103515245u + 12345u;
+	return *state >> 1;
+}
+
+// arcalloc after random mixes of allocations, resets, rewinds and
+// resizes: the dirty marks must always cover what was written
+static void test_dirty_marks(void) {
+	static const ArenaResetMode modes[] = {
+		AR_RESET_KEEP, AR_RESET_TRIM, AR_RESET_FREE, AR_RESET_ADAPTIVE, AR_RESET_COALESCE,
+	};
+	ArenaConfig configs[7] = { { 0 } };
+
+	configs[0].type = AR_FIXED;
+	configs[0].initial_size = 100000;
+	configs[0].max_size = 100000;
+	configs[1].type = AR_FIXED;
+	configs[2].type = AR_DYNAMIC;
+	configs[3].type = AR_DYNAMIC;
+	configs[3].flags = AR_GUARD_PAGES;
+	configs[4].type = AR_DYNAMIC;
+	configs[4].large_size = 8192;
+	configs[5].type = AR_VIRTUAL;
+	configs[6].type = AR_SHARED;
+
+	uint32_t seed = 1;
+
+	for (size_t c = 0; c < sizeof(configs) / sizeof(configs[0]); c++) {
+		Arena *arena = arinit_ex(&configs[c]);
+
+		CHECK(arena != NULL);
+		if (!arena) continue;
+
+		ArenaMark mark = armark(arena);
+		char *last = NULL;
+		size_t last_size = 0;
+		int zeroed = 1;
+
+		for (int round = 0; round < 5000; round++) {
+			uint32_t r = next_random(&seed);
+			size_t size = r % 3 ? (r >> 8) % 300 + 1 : (r >> 8) % 20000 + 1;
+			char *p = NULL;
+
+			switch ((r >> 4) % 16) {
+			case 0: {
+				ArenaResetPolicy policy = { modes[(r >> 8) % 5], (r >> 12) % (64 << 10) };
+
+				arreset_ex(arena, policy);
+				mark = armark(arena);
+				last = NULL;
+				break;
+			}
+			case 1:
+				arrewind(arena, mark);
+				last = NULL;
+				break;
+			case 2:
+				mark = armark(arena);
+				break;
+			case 3:
+				if (last) p = arrealloc(arena, last, last_size, size);
+				break;
+			case 4:
+			case 5:
+			case 6:
+			case 7:
+				p = arcalloc(arena, 1, size);
+				if (p && !all_zero((unsigned char *)p, size)) zeroed = 0;
+				break;
+			default:
+				p = aralloc(arena, size);
+			}
+
+			if (p) {
+				memset(p, 0xa5, size);
+				last = p;
+				last_size = size;
+			}
+		}
+
+		if (!zeroed) fprintf(stderr, "config %zu: arcalloc saw old bytes\n", c);
+		CHECK(zeroed);
+		arfree(arena);
+	}
+}
+
+int main(void) {
+	static const struct test tests[] = {
+		{ "reset policies", test_reset_policies },
+		{ "cache and arcalloc", test_cache_zeroing },
+		{ "huge pages", test_hugepages },
+		{ "file arenas", test_file_arenas },
+		{ "large allocations", test_large },
+		{ "refill", test_refill },
+		{ "mark and rewind", test_mark_rewind },
+		{ "aligned", test_aligned },
+		{ "arrealloc", test_realloc },
+		{ "batches", test_batch },
+		{ "containers", test_containers },
+		{ "pools", test_pools },
+		{ "rings", test_rings },
+		{ "thread-local", test_thread_local },
+		{ "shared", test_shared },
+		{ "stats", test_stats },
+		{ "dirty marks", test_dirty_marks },
+	};
+
+	return RUN_TESTS(tests);
+}
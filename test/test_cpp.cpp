@@ -0,0 +1,127 @@
+// C++ adapter tests: StaticArena, ArenaAllocator and ArenaResource, see
+// check.h. Built with -fno-rtti, links test_impl.c.
+
+#include "arena.h"
+#include "check.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#include <map>
+#include <memory_resource>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct Holder {
+	int x;
+	StaticArena<256, 64> arena;
+};
+
+static void test_static_arena() {
+	StaticArena<1024> scratch;
+
+	CHECK(scratch.used() == 0 && !scratch.overflow());
+
+	char *p = (char *)scratch.alloc(10);
+	char *q = (char *)scratch.alloc(10);
+	char *r = (char *)scratch.alloc_aligned(8, 256);
+
+	CHECK(p && ((uintptr_t)p & 15) == 0 && q == p + 16);
+	CHECK(r && ((uintptr_t)r & 255) == 0);
+	CHECK(!scratch.alloc_aligned(8, 3));
+
+	// the buffer fills up before anything spills
+	while (scratch.used() + 16 <= 1024) CHECK(scratch.alloc(16) != NULL);
+	CHECK(!scratch.overflow());
+
+	char *big = (char *)scratch.alloc(100000);
+	char *aligned = (char *)scratch.alloc_aligned(100, 4096);
+
+	CHECK(big && scratch.overflow());
+	CHECK(aligned && ((uintptr_t)aligned & 4095) == 0);
+	if (big) memset(big, 1, 100000);
+
+	// reset keeps the overflow arena for next time
+	scratch.reset();
+	CHECK(scratch.used() == 0 && scratch.overflow());
+	CHECK(scratch.alloc(1000) == p);
+
+	Holder holder;
+
+	CHECK(((uintptr_t)holder.arena.alloc(1) & 63) == 0);
+
+	StaticArena<1, 1> tiny;
+
+	CHECK(tiny.alloc(1) && tiny.alloc(1) && tiny.overflow());
+}
+
+static void test_allocator() {
+	Arena *arena = arinit(AR_DYNAMIC);
+
+	{
+		std::vector<int, ArenaAllocator<int> > vec((ArenaAllocator<int>(arena)));
+		int intact = 1;
+
+		for (int i = 0; i < 10000; i++) vec.push_back(i);
+		for (int i = 0; i < 10000; i++)
+			if (vec[i] != i) intact = 0;
+
+		CHECK(intact);
+
+		typedef std::pair<const int, std::string> Entry;
+		typedef std::map<int, std::string, std::less<int>, ArenaAllocator<Entry> > Map;
+
+		std::less<int> less;
+		Map map(less, ArenaAllocator<Entry>(arena));
+
+		for (int i = 0; i < 100; i++) map[i] = "x";
+		CHECK(map.size() == 100 && map[42] == "x");
+
+		// rebound copies draw from the same arena
+		ArenaAllocator<char> chars(vec.get_allocator());
+
+		CHECK(chars == vec.get_allocator() && chars.arena() == arena);
+		CHECK(ArenaAllocator<int>(NULL) != vec.get_allocator());
+	}
+
+	arfree(arena);
+}
+
+static void test_resource() {
+	Arena *arena = arinit(AR_DYNAMIC);
+
+	{
+		ArenaResource resource(arena);
+		std::pmr::vector<std::pmr::string> names(&resource);
+		std::pmr::unordered_map<int, int> map(&resource);
+
+		for (int i = 0; i < 1000; i++)
+			names.emplace_back("a string too long for the small buffer");
+		for (int i = 0; i < 1000; i++) map[i] = i;
+
+		CHECK(names.size() == 1000 && names[999] == names[0] && map[999] == 999);
+
+		void *p = resource.allocate(100, 256);
+
+		CHECK(((uintptr_t)p & 255) == 0);
+
+		// only the same resource can take memory back
+		ArenaResource other(arena);
+
+		CHECK(resource == resource && !(resource == other));
+		CHECK(resource.arena() == arena);
+	}
+
+	arfree(arena);
+}
+
+int main() {
+	static const struct test tests[] = {
+		{ "static arena", test_static_arena },
+		{ "allocator", test_allocator },
+		{ "memory resource", test_resource },
+	};
+
+	return RUN_TESTS(tests);
+}
@@ -0,0 +1,218 @@
+// ARENA_DEBUG tests: redzones, archeck and poisoning, see check.h.
+//
+// Under ASan, freed memory is poisoned and touching it kills the
+// process, those checks run in a child. Without it (test-tsan) freed
+// memory is filled with 0xdd.
+
+#define ARENA_DEBUG
+#define ARENA_IMPLEMENTATION
+
+static int debug_fails;
+static void *debug_last;
+
+// count corruption rather than trap
+#define ARENA_DEBUG_FAIL(arena, ptr) (debug_fails++, debug_last = (ptr))
+
+#include "arena.h"
+#include "check.h"
+
+#include <stdint.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+static int all_zero(const unsigned char *p, size_t n) {
+	for (size_t i = 0; i < n; i++)
+		if (p[i]) return 0;
+
+	return 1;
+}
+
+// writes past what ASan lets through, like a stray pointer would
+#ifdef __SANITIZE_ADDRESS__
+__attribute__((no_sanitize_address))
+#endif
+static void poke(char *p, char value) {
+	*(volatile char *)p = value;
+}
+
+// whether <fn> kills a child process
+static int dies(void (*fn)(void)) {
+	fflush(stdout);
+
+	pid_t pid = fork();
+
+	if (pid == 0) {
+		int fd = open("/dev/null", O_WRONLY);
+
+		dup2(fd, 2);
+		fn();
+		_exit(0);
+	}
+
+	int status;
+
+	waitpid(pid, &status, 0);
+	return !(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+}
+
+static void test_redzones(void) {
+	for (int type = AR_FIXED; type <= AR_SHARED; type++) {
+		Arena *arena = arinit((ArenaType)type);
+		char *p = aralloc(arena, 20);
+		char *aligned = aralloc_aligned(arena, 100, 4096);
+
+		debug_fails = 0;
+		CHECK(p && ((uintptr_t)p & 15) == 0);
+		CHECK(aligned && ((uintptr_t)aligned & 4095) == 0);
+		memset(p, 1, 20);
+		memset(aligned, 2, 100);
+		CHECK(archeck(arena) == 0);
+
+		// one byte past the end is seen by archeck and again by the reset
+		poke(p + 20, 9);
+		CHECK(archeck(arena) == -1 && debug_fails == 1 && debug_last == p);
+		arreset(arena);
+		CHECK(debug_fails == 2 && archeck(arena) == 0);
+
+		// and by a rewind over it
+		char *kept = aralloc(arena, 8);
+		ArenaMark mark = armark(arena);
+
+		for (int i = 0; i < 100; i++) {
+			char *s = aralloc(arena, 300);
+
+			CHECK(s != NULL);
+			if (!s) break;
+
+			memset(s, 3, 300);
+			if (i == 50) poke(s - 1, 0);
+		}
+
+		arrewind(arena, mark);
+		CHECK(debug_fails == 3);
+
+		// in front of the mark, it stays
+		poke(kept + 9, 0);
+		CHECK(archeck(arena) == -1);
+		arreset(arena);
+
+		// resized and zeroed allocations get redzones too
+		debug_fails = 0;
+
+		unsigned char *zeros = arcalloc(arena, 1, 500);
+
+		CHECK(zeros && all_zero(zeros, 500));
+
+		char *grown = arrealloc(arena, NULL, 0, 10);
+
+		memset(grown, 5, 10);
+		grown = arrealloc(arena, grown, 10, 40);
+		CHECK(grown && grown[9] == 5);
+		CHECK(archeck(arena) == 0);
+		arfree(arena);
+		CHECK(debug_fails == 0);
+	}
+}
+
+static Arena *shared;
+
+static void *shared_worker(void *unused) {
+	(void)unused;
+
+	for (int i = 0; i < 5000; i++) {
+		char *p = aralloc(shared, (size_t)(i % 100));
+
+		CHECK(p != NULL);
+		if (p) memset(p, 7, (size_t)(i % 100));
+	}
+
+	return NULL;
+}
+
+static void test_shared(void) {
+	pthread_t threads[4];
+
+	debug_fails = 0;
+	shared = arinit(AR_SHARED);
+
+	for (int i = 0; i < 4; i++) pthread_create(&threads[i], NULL, shared_worker, NULL);
+	for (int i = 0; i < 4; i++) pthread_join(threads[i], NULL);
+
+	CHECK(archeck(shared) == 0);
+	arfree(shared);
+	CHECK(debug_fails == 0);
+}
+
+static void past_guard(void) {
+	ArenaConfig config = { 0 };
+
+	config.type = AR_FIXED;
+	config.initial_size = 4096;
+	config.flags = AR_GUARD_PAGES;
+
+	Arena *arena = arinit_ex(&config);
+	char *p = aralloc(arena, 100);
+
+	for (size_t i = 0; i < 2 * AR_PAGE_SIZE; i++) poke(p + i, 1);
+}
+
+static void use_after_reset(void) {
+	Arena *arena = arinit(AR_DYNAMIC);
+	char *p = aralloc(arena, 64);
+
+	arreset(arena);
+	p[3] = 1;
+}
+
+static void overrun(void) {
+	Arena *arena = arinit(AR_DYNAMIC);
+	char *p = aralloc(arena, 20);
+
+	p[20] = 1;
+}
+
+static void test_poisoning(void) {
+	CHECK(dies(past_guard));
+
+	// guarded chunks survive growth and coalescing
+	ArenaConfig config = { 0 };
+	ArenaResetPolicy coalesce = { AR_RESET_COALESCE, 0 };
+
+	config.type = AR_DYNAMIC;
+	config.flags = AR_GUARD_PAGES;
+
+	Arena *arena = arinit_ex(&config);
+
+	for (int i = 0; i < 5000; i++) memset(aralloc(arena, 1000), 1, 1000);
+	arreset_ex(arena, coalesce);
+	for (int i = 0; i < 5000; i++) memset(aralloc(arena, 1000), 1, 1000);
+	arfree(arena);
+
+#ifdef AR_ASAN
+	CHECK(dies(use_after_reset));
+	CHECK(dies(overrun));
+#else
+	(void)use_after_reset;
+	(void)overrun;
+
+	arena = arinit(AR_DYNAMIC);
+
+	unsigned char *p = aralloc(arena, 64);
+
+	memset(p, 0, 64);
+	arreset(arena);
+	CHECK(p[3] == 0xdd);
+	arfree(arena);
+#endif
+}
+
+int main(void) {
+	static const struct test tests[] = {
+		{ "redzones", test_redzones },
+		{ "debug shared", test_shared },
+		{ "poisoning", test_poisoning },
+	};
+
+	return RUN_TESTS(tests);
+}
@@ -0,0 +1,3 @@
+// the implementation is C, test_cpp.cpp links against this
+#define ARENA_IMPLEMENTATION
+#include "arena.h"
@@ -0,0 +1,139 @@
+// ARENA_PROFILE tests: sampling, tags and both output formats, see
+// check.h.
+
+#define ARENA_PROFILE
+#define ARENA_INLINE
+#define ARENA_IMPLEMENTATION
+#include "arena.h"
+#include "check.h"
+
+#include <string.h>
+
+static char out[1 << 20];
+
+// arprof_write into <out>
+static void dump(Arena *arena, ArenaProfileFormat format) {
+	FILE *tmp = tmpfile();
+
+	out[0] = 0;
+	CHECK(tmp != NULL);
+	if (!tmp) return;
+
+	CHECK(arprof_write(arena, fileno(tmp), format) == 0);
+	rewind(tmp);
+	out[fread(out, 1, sizeof(out) - 1, tmp)] = 0;
+	fclose(tmp);
+}
+
+__attribute__((noinline)) static void big_site(Arena *arena) {
+	for (int i = 0; i < 3000; i++) CHECK(aralloc(arena, 1024) != NULL);
+}
+
+__attribute__((noinline)) static void small_site(Arena *arena) {
+	for (int i = 0; i < 3000; i++) CHECK(aralloc_fast(arena, 64) != NULL);
+}
+
+static void test_sampling(void) {
+	arprof_interval(16 << 10);
+
+	Arena *arena = arinit(AR_DYNAMIC);
+
+	CHECK(arprof_tag("big") == NULL);
+	big_site(arena);
+	CHECK(strcmp(arprof_tag(NULL), "big") == 0);
+	small_site(arena);
+
+	// folded stacks: the tag leads the stack, byte counts come out
+	// close to what was allocated at each site
+	size_t big = 0;
+	size_t other = 0;
+
+	dump(arena, AR_PROFILE_FOLDED);
+
+	for (char *line = out; *line; ) {
+		char *end = strchr(line, '\n');
+
+		CHECK(end != NULL);
+		if (!end) break;
+
+		*end = 0;
+
+		size_t bytes = strtoull(strrchr(line, ' ') + 1, NULL, 10);
+
+		if (strncmp(line, "big;0x", 6) == 0) big += bytes;
+		else if (strncmp(line, "0x", 2) == 0) other += bytes;
+		else CHECK(!"untagged line without a stack");
+
+		line = end + 1;
+	}
+
+	CHECK(big > 3000 * 1024 / 2 && big < 3000 * 1024 * 2);
+	CHECK(other > 3000 * 64 / 2 && other < 3000 * 64 * 2);
+
+	dump(arena, AR_PROFILE_PPROF);
+	CHECK(strncmp(out, "heap profile: ", 14) == 0);
+	CHECK(strstr(out, "] @ heapprofile\n") && strstr(out, "\nMAPPED_LIBRARIES:\n"));
+
+	// reset drops the samples
+	arreset(arena);
+	dump(arena, AR_PROFILE_FOLDED);
+	CHECK(out[0] == 0);
+
+	// sampling stops at the next sample, then comes back once the
+	// idle countdown runs out
+	arprof_interval(0);
+	big_site(arena);
+	arreset(arena);
+	big_site(arena);
+	dump(arena, AR_PROFILE_FOLDED);
+	CHECK(out[0] == 0);
+	arprof_interval(16 << 10);
+	for (int i = 0; i < 30; i++) big_site(arena);
+	dump(arena, AR_PROFILE_FOLDED);
+	CHECK(out[0] != 0);
+	arfree(arena);
+	arprof_tag(NULL);
+}
+
+static Arena *shared;
+
+static void *shared_worker(void *unused) {
+	(void)unused;
+	arprof_tag("worker");
+
+	for (int i = 0; i < 20000; i++) CHECK(aralloc(shared, 256) != NULL);
+
+	return NULL;
+}
+
+static void test_shared(void) {
+	pthread_t threads[4];
+
+	// tags are per thread
+	shared = arinit(AR_SHARED);
+
+	for (int i = 0; i < 4; i++) pthread_create(&threads[i], NULL, shared_worker, NULL);
+	for (int i = 0; i < 4; i++) pthread_join(threads[i], NULL);
+
+	dump(shared, AR_PROFILE_FOLDED);
+	CHECK(strncmp(out, "worker;", 7) == 0);
+	arfree(shared);
+	CHECK(arprof_tag(NULL) == NULL);
+
+	// nothing sampled, an empty profile
+	Arena *arena = arinit(AR_FIXED);
+
+	dump(arena, AR_PROFILE_PPROF);
+	CHECK(strncmp(out, "heap profile: 0: 0 [ 0: 0] @ heapprofile\n", 41) == 0);
+	arfree(arena);
+	CHECK(arprof_write(NULL, 1, AR_PROFILE_PPROF) == -1);
+}
+
+int main(void) {
+	static const struct test tests[] = {
+		{ "sampling", test_sampling },
+		{ "profile shared", test_shared },
+	};
+
+	return RUN_TESTS(tests);
+}